@@ -0,0 +1,134 @@
+//
+// decFormat.c
+//
+// Unsigned integer to decimal conversion by power of ten
+// subtraction, for all the numbers the node sends.
+//
+// Author: Richard C Clarke
+// Date: March 2009
+//
+
+
+// includes
+
+#include <stddef.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+
+#include <inttypes.h>
+
+#include "global.h"
+#include "uart.h"
+#include "decFormat.h"
+
+/*Place value of each digit, most significant first*/
+static const uint32_t decPowers[DEC_DIGITS_MAX] PROGMEM =
+{
+	1000000000UL,
+	100000000UL,
+	10000000UL,
+	1000000UL,
+	100000UL,
+	10000UL,
+	1000UL,
+	100UL,
+	10UL,
+	1UL
+};
+
+
+static char *decEmit(char *p, uint32_t value, uint8_t width, uint8_t decimals);
+
+
+
+/*Common to decFormat() and decPut(). Characters go to p, or straight to the UART if p is NULL*/
+static char *decEmit(char *p, uint32_t value, uint8_t width, uint8_t decimals)
+{
+	uint8_t digits;
+	uint8_t len;
+	uint8_t i;
+	uint32_t power;
+	char c;
+
+	/*Count the significant digits first, the padding has to go out before any of them*/
+	digits = DEC_DIGITS_MAX;
+	while( (digits > 1) && (value < pgm_read_dword(&decPowers[DEC_DIGITS_MAX - digits])) )
+	{
+		digits--;
+	}
+	if(digits <= decimals)
+	{
+		digits = decimals + 1;
+	}
+
+	len = digits;
+	if(decimals)
+	{
+		len++;
+	}
+
+	for(;width > len;width--)
+	{
+		if(p)
+		{
+			*p++ = ' ';
+		}
+		else
+		{
+			uart_putc(' ');
+		}
+	}
+
+	for(i=DEC_DIGITS_MAX - digits;i<DEC_DIGITS_MAX;i++)
+	{
+		if( decimals && ((DEC_DIGITS_MAX - i) == decimals) )
+		{
+			if(p)
+			{
+				*p++ = '.';
+			}
+			else
+			{
+				uart_putc('.');
+			}
+		}
+
+		power = pgm_read_dword(&decPowers[i]);
+		c = '0';
+		while(value >= power)
+		{
+			value -= power;
+			c++;
+		}
+
+		if(p)
+		{
+			*p++ = c;
+		}
+		else
+		{
+			uart_putc(c);
+		}
+	}
+
+	if(p)
+	{
+		*p = '\0';
+	}
+
+	return p;
+}
+
+
+
+char *decFormat(char *buf, uint32_t value, uint8_t width, uint8_t decimals)
+{
+	return decEmit(buf, value, width, decimals);
+}
+
+
+
+void decPut(uint32_t value, uint8_t width, uint8_t decimals)
+{
+	decEmit(NULL, value, width, decimals);
+}
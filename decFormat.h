@@ -0,0 +1,64 @@
+#ifndef DECFORMAT_H
+#define DECFORMAT_H
+/************************************************************************
+Title:    Division free decimal formatting of unsigned integers
+Author:   Richard Clarke <richard@clarke.biz>
+File:     $Id:  $
+Software: AVR-GCC 4.1, AVR Libc 1.4
+Hardware: ATMega328P
+License:  GNU General Public License
+
+LICENSE:
+    Copyright (C) 2009 Richard Clarke
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+************************************************************************/
+#include <inttypes.h>
+
+#include "global.h"
+
+/*Most digits a uint32_t can have*/
+#define DEC_DIGITS_MAX		10
+
+/*Longest string decFormat() can produce without padding, all the digits, a decimal point and
+the terminator*/
+#define DEC_FORMAT_MAX		(DEC_DIGITS_MAX + 2)
+
+/*************************************************************************
+Each digit is found by subtracting the power of ten for its position until the value drops
+below it, so a 32 bit value takes at most 90 compare and subtract steps and no division at all.
+ultoa() and utoa() need a 32 bit divide by 10 per digit, which the ATMega has no instruction for.
+
+width     minimum number of characters, the number is padded on the left with spaces to fill it.
+          0 for no padding
+decimals  number of digits after the decimal point, for values held in fixed point, e.g. 2 for
+          kW x 100. There is always at least one digit in front of the point, so 5 with 2 decimals
+          comes out as "0.05". 0 for a plain integer. Must be less than DEC_DIGITS_MAX
+**************************************************************************/
+
+/*************************************************************************
+Function: decFormat()
+Purpose:  write value in decimal into buf, followed by a terminator. buf must have room for
+          DEC_FORMAT_MAX characters, or width + 1 if that is more
+Returns:  pointer to the terminator, so further text can be appended
+**************************************************************************/
+extern char *decFormat(char *buf, uint32_t value, uint8_t width, uint8_t decimals);
+
+/*************************************************************************
+Function: decPut()
+Purpose:  send value in decimal with uart_putc(), a digit at a time as each one is
+          worked out, without building the string first
+**************************************************************************/
+extern void decPut(uint32_t value, uint8_t width, uint8_t decimals);
+
+
+#endif
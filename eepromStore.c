@@ -0,0 +1,249 @@
+//
+// eepromStore.c
+//
+// Checkpoints totalPulseCount and the settings into a wear levelled
+// ring of EEPROM records, and restores them at boot.
+//
+// Author: Richard C Clarke
+// Date: March 2009
+//
+
+
+// includes
+
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+
+#include <inttypes.h>
+
+#include "global.h"
+#include "timer.h"
+#include "pulseCapture.h"
+#include "processPulse.h"
+#include "reportFrame.h"
+#include "eepromStore.h"
+
+extern uint32_t totalPulseCount;
+extern uint8_t averageWindow;
+extern uint8_t emaShift;
+extern uint8_t commandFlags;
+extern uint16_t reportThreshold;
+extern uint8_t baudIndex;
+extern uint8_t nodeAddress;
+
+/*Byte index used for eepromWriteIndex when no checkpoint is being written*/
+#define EEPROM_WRITE_IDLE		0xFF
+
+#define EEPROM_CHECKPOINT_MIN_TICKS	((uint32_t)EEPROM_CHECKPOINT_MIN_SECS * TIMER_TICK_RATE)
+
+/*The ring itself. Left uninitialised so programming the flash doesn't touch it*/
+static struct eepromRecord_t eepromRing[EEPROM_RING_SLOTS] EEMEM;
+
+/*RAM image of the checkpoint being written, and the next byte of it to go out*/
+static struct eepromRecord_t eepromImage;
+static uint8_t eepromWriteIndex;
+
+/*Slot and sequence number the next checkpoint will use*/
+static uint8_t eepromSlot;
+static uint16_t eepromSeq;
+
+/*totalPulseCount and Timer1 timestamp when the last checkpoint was started*/
+static uint32_t eepromLastCount;
+static uint32_t eepromLastTime;
+
+/*Set when a command has changed something that should be saved*/
+static BOOL eepromDirty;
+
+
+static uint16_t eepromRecordCrc(struct eepromRecord_t *record);
+
+
+
+static uint16_t eepromRecordCrc(struct eepromRecord_t *record)
+{
+	uint16_t crc;
+	uint8_t *p;
+	uint8_t i;
+
+	crc = 0xFFFF;
+	p = (uint8_t *)record;
+	for(i=0;i<(sizeof(struct eepromRecord_t) - sizeof(uint16_t));i++)
+	{
+		crc = _crc_ccitt_update(crc, p[i]);
+	}
+
+	return crc;
+}
+
+
+
+uint8_t eepromStoreInit()
+{
+	struct eepromRecord_t record;
+	uint8_t slot;
+	BOOL found;
+
+	eepromWriteIndex = EEPROM_WRITE_IDLE;
+	eepromDirty = FALSE;
+	eepromSlot = 0;
+	eepromSeq = 0;
+	found = FALSE;
+
+	/*The newest record is the valid one with the highest sequence number. The sequence numbers
+	in the ring are always within EEPROM_RING_SLOTS of each other, so comparing the signed
+	difference works across the 16 bit wrap*/
+	for(slot=0;slot<EEPROM_RING_SLOTS;slot++)
+	{
+		eeprom_read_block(&record, &eepromRing[slot], sizeof(struct eepromRecord_t));
+
+		if(record.crc != eepromRecordCrc(&record))
+		{
+			continue;
+		}
+
+		if( !found || ((int16_t)(record.seq - eepromImage.seq) > 0) )
+		{
+			eepromImage = record;
+			eepromSlot = slot;
+			found = TRUE;
+		}
+	}
+
+	if(found)
+	{
+		totalPulseCount = eepromImage.totalPulseCount;
+		energySetPulses(totalPulseCount);
+
+		/*Range check the settings as well, in case they were written by a build with
+		different limits. Anything out of range keeps its default*/
+		if( (eepromImage.averageWindow >= 1) && (eepromImage.averageWindow <= AVG_WINDOW_MAX) )
+		{
+			averageWindow = eepromImage.averageWindow;
+		}
+		if( (eepromImage.emaShift >= EMA_SHIFT_MIN) && (eepromImage.emaShift <= EMA_SHIFT_MAX) )
+		{
+			emaShift = eepromImage.emaShift;
+		}
+		if(eepromImage.reportFormat <= REPORT_FORMAT_BINARY)
+		{
+			reportFormat = eepromImage.reportFormat;
+		}
+		if( (eepromImage.reportMode & ~REPORT_MODE_MASK) == 0 )
+		{
+			commandFlags = eepromImage.reportMode;
+		}
+		reportThreshold = eepromImage.reportThreshold;
+		/*Range checked by main(), which knows the baud table*/
+		baudIndex = eepromImage.baudIndex;
+		nodeAddress = eepromImage.nodeAddress;
+#if PULSE_WIDTH_QUALIFY
+		/*Open the window right up first, so the new limits can be set in either order*/
+		if(eepromImage.pulseWidthMin <= eepromImage.pulseWidthMax)
+		{
+			pulseWidthSetMax(MAX_U16);
+			pulseWidthSetMin(eepromImage.pulseWidthMin);
+			pulseWidthSetMax(eepromImage.pulseWidthMax);
+		}
+#endif
+
+		/*Carry on round the ring from the slot after the one restored*/
+		eepromSeq = eepromImage.seq + 1;
+		eepromSlot++;
+		if(eepromSlot >= EEPROM_RING_SLOTS)
+		{
+			eepromSlot = 0;
+		}
+	}
+
+	eepromLastCount = totalPulseCount;
+	eepromLastTime = timer1GetTimestamp();
+
+	return found;
+}
+
+
+
+void eepromStoreRequest()
+{
+	eepromDirty = TRUE;
+}
+
+
+
+uint8_t eepromStoreBusy()
+{
+	return (eepromWriteIndex != EEPROM_WRITE_IDLE);
+}
+
+
+
+void eepromStoreService()
+{
+	uint8_t *p;
+
+	if(eepromWriteIndex == EEPROM_WRITE_IDLE)
+	{
+		/*Nothing being written, see if a checkpoint is due. One asked for by a command goes
+		straight away, only those due to pulses are spaced out. Unsigned differences so the
+		timestamp wrapping after 13.8 days doesn't matter*/
+		if(!eepromDirty)
+		{
+			if( (timer1GetTimestamp() - eepromLastTime) < EEPROM_CHECKPOINT_MIN_TICKS )
+			{
+				return;
+			}
+			if( (totalPulseCount - eepromLastCount) < EEPROM_CHECKPOINT_PULSES )
+			{
+				return;
+			}
+		}
+
+		/*Take a snapshot to write out, the live values can carry on changing meanwhile*/
+		eepromImage.seq = eepromSeq;
+		eepromImage.totalPulseCount = totalPulseCount;
+		eepromImage.averageWindow = averageWindow;
+		eepromImage.emaShift = emaShift;
+#if PULSE_WIDTH_QUALIFY
+		eepromImage.pulseWidthMin = pulseWidthGetMin();
+		eepromImage.pulseWidthMax = pulseWidthGetMax();
+#else
+		eepromImage.pulseWidthMin = PULSE_WIDTH_MIN_DEFAULT;
+		eepromImage.pulseWidthMax = PULSE_WIDTH_MAX_DEFAULT;
+#endif
+		eepromImage.reportFormat = reportFormat;
+		eepromImage.reportMode = commandFlags;
+		eepromImage.reportThreshold = reportThreshold;
+		eepromImage.baudIndex = baudIndex;
+		eepromImage.nodeAddress = nodeAddress;
+		eepromImage.crc = eepromRecordCrc(&eepromImage);
+
+		eepromLastCount = totalPulseCount;
+		eepromLastTime = timer1GetTimestamp();
+		eepromDirty = FALSE;
+		eepromWriteIndex = 0;
+	}
+
+	/*One byte per call, and only when the last one has finished, so the main loop never sits
+	waiting the 3.4ms an EEPROM write takes. eeprom_update_byte() skips bytes that haven't
+	changed, which saves wear on the slowly changing fields*/
+	if(!eeprom_is_ready())
+	{
+		return;
+	}
+
+	p = (uint8_t *)&eepromRing[eepromSlot];
+	eeprom_update_byte(&p[eepromWriteIndex], ((uint8_t *)&eepromImage)[eepromWriteIndex]);
+	eepromWriteIndex++;
+
+	if(eepromWriteIndex >= sizeof(struct eepromRecord_t))
+	{
+		eepromWriteIndex = EEPROM_WRITE_IDLE;
+		eepromSeq++;
+		eepromSlot++;
+		if(eepromSlot >= EEPROM_RING_SLOTS)
+		{
+			eepromSlot = 0;
+		}
+	}
+}
@@ -0,0 +1,95 @@
+#ifndef EEPROMSTORE_H
+#define EEPROMSTORE_H
+/************************************************************************
+Title:    Wear levelled EEPROM checkpoint of the pulse count and settings
+Author:   Richard Clarke <richard@clarke.biz>
+File:     $Id:  $
+Software: AVR-GCC 4.1, AVR Libc 1.4
+Hardware: ATMega328P
+License:  GNU General Public License
+
+LICENSE:
+    Copyright (C) 2009 Richard Clarke
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+************************************************************************/
+#include <inttypes.h>
+
+#include "global.h"
+
+/*Checkpoints are written round a ring of EEPROM_RING_SLOTS records, each one tagged with a
+sequence number and protected by a CRC. At boot the newest record with a good CRC is restored, so
+a checkpoint cut short by a brownout just falls back to the one before it.
+
+Endurance. A checkpoint due to pulses is never written less than EEPROM_CHECKPOINT_MIN_SECS after
+the last one, whatever the load, so there can be at most 12 an hour. Over 10 years that is 1051200
+checkpoints, spread over 32 slots is 32850 writes per cell against the 100000 the ATMega328P EEPROM
+is rated for. At a more typical 1kW average 160 pulses take 6 minutes, and each cell sees about
+27000 writes in 10 years. A checkpoint asked for by a command is written straight away, so a reset
+or a new setting can't be lost to a reset in the next few minutes. Even 100 of those a day only
+add another 11400 writes per cell in 10 years*/
+#define EEPROM_RING_SLOTS			32
+
+/*Pulses to count before a checkpoint is due, 160 pulses is 0.1kWh*/
+#define EEPROM_CHECKPOINT_PULSES	160
+
+/*Shortest time between checkpoints, in seconds*/
+#define EEPROM_CHECKPOINT_MIN_SECS	300
+
+/*One checkpoint. The CRC must stay the last member, it is written last so that a torn write
+can never leave a record that passes the CRC check*/
+struct eepromRecord_t
+{
+	uint16_t seq;				/*incremented every checkpoint, the newest record wins*/
+	uint32_t totalPulseCount;
+	uint8_t averageWindow;
+	uint8_t emaShift;
+	uint16_t pulseWidthMin;
+	uint16_t pulseWidthMax;
+	uint8_t reportFormat;
+	uint8_t reportMode;
+	uint16_t reportThreshold;
+	uint8_t baudIndex;
+	uint8_t nodeAddress;
+	uint16_t crc;				/*CCITT CRC of everything above*/
+};
+
+
+/*************************************************************************
+Function: eepromStoreInit()
+Purpose:  find the newest valid checkpoint and restore totalPulseCount and the
+		  settings from it. The energy register is rebuilt from the count.
+		  Call once at start up, after the defaults have been set up and
+		  with Timer1 running.
+Returns:  TRUE if a checkpoint was restored, FALSE if the defaults were kept
+**************************************************************************/
+extern uint8_t eepromStoreInit(void);
+
+/*************************************************************************
+Function: eepromStoreService()
+Purpose:  start a checkpoint when one is due, and write the next byte of a
+		  checkpoint in progress if the EEPROM is ready for it. Never waits on
+		  the EEPROM. Call on every pass of the main loop.
+**************************************************************************/
+extern void eepromStoreService(void);
+
+/*Ask for a checkpoint at the next opportunity, after a setting or totalPulseCount has been
+changed by a command. Not held back by EEPROM_CHECKPOINT_MIN_SECS. If a checkpoint is already
+being written another one follows it, as the change may have missed the snapshot*/
+extern void eepromStoreRequest(void);
+
+/*TRUE while a checkpoint is being written out. Nothing interrupts when the EEPROM is ready for the
+next byte, so the main loop mustn't sleep until it is done*/
+extern uint8_t eepromStoreBusy(void);
+
+
+#endif
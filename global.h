@@ -1,40 +1,51 @@
-/*! \file global.h \brief AVRlib project global include. */
-//*****************************************************************************
-//
-// File Name	: 'global.h'
-// Title		: AVRlib project global include 
-// Author		: Pascal Stang - Copyright (C) 2001-2002
-// Created		: 7/12/2001
-// Revised		: 9/30/2002
-// Version		: 1.1
-// Target MCU	: Atmel AVR series
-// Editor Tabs	: 4
-//
-//	Description : This include file is designed to contain items useful to all
-//					code files and projects.
-//
-// This code is distributed under the GNU Public License
-//		which can be found at http://www.gnu.org/licenses/gpl.txt
-//
-//*****************************************************************************
-
-#ifndef GLOBAL_H
-#define GLOBAL_H
-
-// global AVRLIB defines
-#include "avrlibdefs.h"
-// global AVRLIB types definitions
-#include "avrlibtypes.h"
-
-// project/system dependent defines
-
-// CPU clock speed
-//#define F_CPU        16000000               		// 16MHz processor
-//#define F_CPU        14745000               		// 14.745MHz processor
-//#define F_CPU        8000000               		// 8MHz processor
-//#define F_CPU        7372800               		// 7.37MHz processor
-//#define F_CPU        4000000               		// 4MHz processor
-//#define F_CPU        3686400               		// 3.69MHz processor
-#define CYCLES_PER_US ((F_CPU+500000)/1000000) 	// cpu cycles per microsecond
-
-#endif
+/*! \file global.h \brief AVRlib project global include. */
+//*****************************************************************************
+//
+// File Name	: 'global.h'
+// Title		: AVRlib project global include 
+// Author		: Pascal Stang - Copyright (C) 2001-2002
+// Created		: 7/12/2001
+// Revised		: 9/30/2002
+// Version		: 1.1
+// Target MCU	: Atmel AVR series
+// Editor Tabs	: 4
+//
+//	Description : This include file is designed to contain items useful to all
+//					code files and projects.
+//
+// This code is distributed under the GNU Public License
+//		which can be found at http://www.gnu.org/licenses/gpl.txt
+//
+//*****************************************************************************
+
+#ifndef GLOBAL_H
+#define GLOBAL_H
+
+// global AVRLIB defines
+#include "avrlibdefs.h"
+// global AVRLIB types definitions
+#include "avrlibtypes.h"
+
+// project/system dependent defines
+
+// CPU clock speed
+//#define F_CPU        16000000               		// 16MHz processor
+//#define F_CPU        14745000               		// 14.745MHz processor
+//#define F_CPU        8000000               		// 8MHz processor
+//#define F_CPU        7372800               		// 7.37MHz processor
+//#define F_CPU        4000000               		// 4MHz processor
+//#define F_CPU        3686400               		// 3.69MHz processor
+#define CYCLES_PER_US ((F_CPU+500000)/1000000) 	// cpu cycles per microsecond
+
+// wake up accounting for the idle sleep in the main loop. Each interrupt that
+// can end a sleep marks its cause, the main loop counts and clears them
+#define WAKE_PULSE			0	///< meter pulse edge, INT0 or ICP1
+#define WAKE_SERIAL_RX		1	///< hardware UART byte received
+#define WAKE_SERIAL_TX		2	///< hardware UART ready for the next byte, or done
+#define WAKE_TIMER			3	///< timer overflow or compare
+#define WAKE_NUM_CAUSES		4
+
+extern volatile u08 wakeFlags;
+#define WAKE_MARK(cause)	(wakeFlags |= BV(cause))
+
+#endif
@@ -1,140 +1,570 @@
-//
-// processPulse.c
-//
-// Function containing the external pulse processing code
-//
-// Author: Richard C Clarke
-// Date: March 2009
-//
-
-
-// includes
-
-#include <stdlib.h>
-#include <avr/io.h>
-
-#include <inttypes.h>
-
-#include "global.h"
-
-#define KWH_CONST (uint32_t)360e6	/*the number of 0.01ms intervals in 1 hour*/
-#define PULSES_PER_KWH (uint16_t)1600
-
-#define MAX_KW 15
-#define TIMER_TICK_RATE 3600 /*per second, determined by F_CPU and TIMER_CLK_DIV1024*/
-
-
-/*#define MIN_TICKS (uint16_t)((float)(TIMER_TICK_RATE/(MAX_KW*PULSES_PER_KWH) )*TIMER_TICK_RATE)*/
-
-#define MIN_TICKS 405	/*Corresponds to 20kW instantaneous load*/
-
-extern volatile BOOL externalPulseFlag;
-extern volatile uint16_t thisTimer1Count;
-extern uint16_t minTimerTicks;
-
-extern uint32_t localTimerTicksSum;
-/*Keeps track of the total number of pulses counted since last reset or variable clear command*/
-extern uint32_t totalPulseCount;
-extern uint16_t localTimerTicksAvg;
-
-extern uint16_t pulse_ticker;
-extern uint16_t minTickError;
-
-/*The number of LED pulses between sending latest measurements out serial port*/
-extern	uint8_t averageWindow;
-
-
-
-
-void processPulse()
-{
-
-	uint16_t localTimerTicks;
-
-	/*Avoid any interrupts of this multibyte volatile variable read/write. If any interrupts occur 
-	whilst we have them disabled they will be processed after we reenable them*/
-	cli();
-	localTimerTicks = thisTimer1Count;
-	
-	sei();
-
-	/*TODO:DEBUG:RCC
-	**Track the minimum interval between external interrupts
-	*/
-	if(localTimerTicks < minTimerTicks)
-	{
-		minTimerTicks = localTimerTicks;
-	}
-
-	/*Build in some protection against the rare event of a glitch causing two interrupts in quick sucession.
-	If the value of localTimerTicks is less than some reasonable value then ignore it, i.e don't use it in the
-	calculation of the next average value. A reasonable minimum value would be the time interval corresponding
-	20kW peak instantaneous power, which is if sustained continuously over a period of an hour would result in
-	20 x 1600 = 32000 pulses, which would thus have a pulse interval of 3600(sec)/32000 = 112.50ms. In terms of 
-	AVR timer ticks this is 0.1125 x 3600 = 405 ticks */
-
-	if(localTimerTicks >= MIN_TICKS)
-	{
-
-		pulse_ticker++;
-		totalPulseCount++;
-		/*tickRate_Hz = (F_CPU/prescaleDiv)*/
-		/*time_ms = (localTimerTicks/tickRate_Hz)*1000
-
-		Result here is time in milliseconds x 10, to give 0.1ms resolution
-		in the calculation, otherwise can only represent times to integer numbers
-		of 1ms increments. In reality due to truncation only get resolution to within
-		about 0.3ms, however this is sufficient.*/
-
-		localTimerTicksSum = localTimerTicksSum + localTimerTicks;
-	}
-	else
-	{
-		minTickError++;
-	} 
-
-	/*pulse_interval_ms_x_10 = (((uint32_t)localTimerTicks*10000)/tickRate_Hz);
-	pulse_interval_sum = pulse_interval_sum + pulse_interval_ms_x_10;*/
-
-	/*Would never expect to see a pulse interval of less than 150ms in normal operation.
-	This equates to a pulse rate of 6.667Hz or 24000/hr or an instantaneous loading of 15kW.
-	If we do measure an interval less than this then it's likely due to erroneous short
-	duration pulses on the ext interrupt input, perhaps due to noise. These should be discarded.
-	The summation above effectively achieves this*/
-	
-
-	/*Output an update of current measured values to the serial port every 10
-	pulse_ticker increments*/
-	if( (pulse_ticker >= (uint8_t)averageWindow) )
-	{
-		//debugInfoOut();
-		
-		/*Calculate the average pulse interval over the last 'averageWindow' pulses.
-		This should reduce the impace of any very short duration pulse intervals measured
-		due to noise or erroneous switching on the ext interrupt pin*/
-		localTimerTicksAvg = (uint16_t)(localTimerTicksSum/averageWindow);
-
-		#if 0
-		uart_puts_P("{");
-		utoa( localTimerTicksAvg, buffer, 10);
-		uart_puts(buffer);
-		uart_puts_P(", ");
-		utoa( minTimerTicks, buffer, 10);
-		uart_puts(buffer);
-		uart_puts_P("}\r\n");
-		#endif
-		//pulse_interval_ms_x_10 = pulse_interval_sum/averageWindow;
-		localTimerTicksSum = 0;
-
-		
-
-		pulse_ticker = 0;
-	}
-
-				
-	externalPulseFlag = 0;
-	
-	//localTimerTicks = 0;
-
-
-}
+//
+// processPulse.c
+//
+// Function containing the external pulse processing code
+//
+// Author: Richard C Clarke
+// Date: March 2009
+//
+
+
+// includes
+
+#include <stdlib.h>
+#include <avr/io.h>
+
+#include <inttypes.h>
+
+#include "global.h"
+#include "timer.h"
+#include "pulseCapture.h"
+#include "processPulse.h"
+#include "profiler.h"
+
+extern uint32_t minTimerTicks;
+
+extern uint32_t localTimerTicksSum;
+/*Keeps track of the total number of pulses counted since last reset or variable clear command*/
+extern uint32_t totalPulseCount;
+
+/*Energy register, totalPulseCount converted to kWh x 100. energyRemainder holds the part of a
+0.01kWh step not yet reached, in units of 1/(100*PULSES_PER_KWH) kWh*/
+static uint32_t energyKWh_x100;
+static uint16_t energyRemainder;
+
+extern uint16_t pulse_ticker;
+
+/*Number of intervals rejected by the glitch filter, one counter per reason*/
+uint16_t pulseRejectCount[REJECT_NUM_REASONS];
+
+/*The number of LED pulses between sending latest measurements out serial port*/
+extern	uint8_t averageWindow;
+/*Smoothing of the exponential average, alpha = 1/2^emaShift*/
+extern	uint8_t emaShift;
+
+/*Extended Timer1 value at the last pulse taken off the pulse queue*/
+static uint32_t lastPulseTimestamp;
+
+/*Boxcar history, the last averageWindow accepted intervals. localTimerTicksSum is kept equal to
+the sum of the intervalFill entries held here, so each new pulse only costs one subtraction and
+one addition however long the window is*/
+static uint32_t intervalHistory[AVG_WINDOW_MAX];
+static uint8_t intervalIndex;
+static uint8_t intervalFill;
+
+/*Exponential average of the interval, fixed point with EMA_FRAC_BITS fractional bits.
+Zero means no interval has been seen yet*/
+static uint32_t intervalEma;
+
+/*Load profile, count of accepted intervals in log2 spaced bins. See intervalHistAdd()*/
+static uint16_t intervalHist[INTERVAL_HIST_BINS];
+
+/*Log of per slot summaries, see intervalLogCount(). intervalLogSeq is the sequence number the
+next entry will get, the entry for sequence number n lives in intervalLog[n % INTERVAL_LOG_SIZE].
+intervalLogFill is how many of the entries hold something. intervalLogPulses and intervalLogTicks
+are the pulses counted and time taken in the slot in progress so far*/
+static uint32_t intervalLog[INTERVAL_LOG_SIZE];
+static uint16_t intervalLogSeq;
+static uint16_t intervalLogFill;
+static uint16_t intervalLogPulses;
+static uint32_t intervalLogTicks;
+
+/*Set when an averaging window completes, handed back by processPulse()*/
+static BOOL windowComplete;
+
+/*Glitch filter state. The last 3 accepted intervals, for the median reference. An interval
+held back as a suspected glitch waiting on the next one to decide, and time from rejected
+intervals still to be merged into the next*/
+static uint32_t filterHistory[3];
+static uint8_t filterFill;
+static uint32_t filterPending;
+static uint32_t filterCarry;
+
+
+static void processInterval(uint32_t localTimerTicks);
+static void acceptInterval(uint32_t localTimerTicks);
+static void intervalHistAdd(uint32_t localTimerTicks);
+static void intervalLogCount(uint16_t pulses, uint32_t ticks);
+static void intervalAvgUpdate(uint32_t localTimerTicks);
+static void energyAddPulse(void);
+
+
+
+void processPulseInit()
+{
+	/*The first interval is measured from start up*/
+	lastPulseTimestamp = timer1GetTimestamp();
+}
+
+
+
+void intervalAvgReset()
+{
+	localTimerTicksSum = 0;
+	intervalIndex = 0;
+	intervalFill = 0;
+	intervalEma = 0;
+
+	/*Start counting a new averaging window. The interval log doesn't depend on the averaging
+	window, so it carries on as it is*/
+	pulse_ticker = 0;
+}
+
+
+
+/*Add an accepted interval to both averages*/
+static void intervalAvgUpdate(uint32_t localTimerTicks)
+{
+	uint32_t sample;
+
+	/*Boxcar, once the window is full swap the oldest interval for the new one*/
+	if(intervalFill < averageWindow)
+	{
+		intervalFill++;
+	}
+	else
+	{
+		localTimerTicksSum -= intervalHistory[intervalIndex];
+	}
+	localTimerTicksSum += localTimerTicks;
+	intervalHistory[intervalIndex] = localTimerTicks;
+
+	intervalIndex++;
+	if(intervalIndex >= averageWindow)
+	{
+		intervalIndex = 0;
+	}
+
+	/*Exponential, ema += (sample - ema)/2^emaShift. Intervals are clamped so the fixed
+	point value can't overflow, 2^28 ticks is nearly 21 hours*/
+	if(localTimerTicks > (0xFFFFFFFFUL >> EMA_FRAC_BITS))
+	{
+		localTimerTicks = (0xFFFFFFFFUL >> EMA_FRAC_BITS);
+	}
+	sample = localTimerTicks << EMA_FRAC_BITS;
+
+	if(intervalEma == 0)
+	{
+		intervalEma = sample;
+	}
+	else if(sample >= intervalEma)
+	{
+		intervalEma += (sample - intervalEma) >> emaShift;
+	}
+	else
+	{
+		intervalEma -= (intervalEma - sample) >> emaShift;
+	}
+}
+
+
+
+uint32_t intervalAvgTicks()
+{
+	if(intervalFill == 0)
+	{
+		return 0;
+	}
+
+	return localTimerTicksSum/intervalFill;
+}
+
+
+
+uint32_t intervalEmaTicks()
+{
+	/*Round to the nearest tick*/
+	return (intervalEma + (1 << (EMA_FRAC_BITS - 1))) >> EMA_FRAC_BITS;
+}
+
+
+
+/*Bin k counts intervals from 2^(k+INTERVAL_HIST_LOG2_MIN) up to just under twice that, with
+everything shorter in bin 0 and everything longer in the last bin. Each bin is an octave of
+load, so a day's pulses fit in a handful of counters*/
+static void intervalHistAdd(uint32_t localTimerTicks)
+{
+	uint8_t bin;
+
+	/*Position of the most significant set bit, a byte at a time then a bit at a time*/
+	bin = 0;
+	if(localTimerTicks >= 0x10000UL)
+	{
+		localTimerTicks >>= 16;
+		bin += 16;
+	}
+	if(localTimerTicks >= 0x100)
+	{
+		localTimerTicks >>= 8;
+		bin += 8;
+	}
+	while(localTimerTicks > 1)
+	{
+		localTimerTicks >>= 1;
+		bin++;
+	}
+
+	if(bin < INTERVAL_HIST_LOG2_MIN)
+	{
+		bin = 0;
+	}
+	else
+	{
+		bin -= INTERVAL_HIST_LOG2_MIN;
+		if(bin >= INTERVAL_HIST_BINS)
+		{
+			bin = INTERVAL_HIST_BINS - 1;
+		}
+	}
+
+	/*Saturate rather than wrap, a full bin still reads as the busiest one*/
+	if(intervalHist[bin] < MAX_U16)
+	{
+		intervalHist[bin]++;
+	}
+}
+
+
+
+uint16_t intervalHistGet(uint8_t bin)
+{
+	return intervalHist[bin];
+}
+
+
+
+void intervalHistClear()
+{
+	uint8_t i;
+
+	for(i=0;i<INTERVAL_HIST_BINS;i++)
+	{
+		intervalHist[i] = 0;
+	}
+}
+
+
+
+/*Add pulses and the time they took to the slot in progress, and close the slot once it has run
+for INTERVAL_LOG_SLOT_TICKS. The ticks left over below a whole log unit are carried into the next
+slot, so the log adds up to the full time*/
+static void intervalLogCount(uint16_t pulses, uint32_t ticks)
+{
+	uint32_t units;
+
+	if(ticks > INTERVAL_LOG_TICKS_MAX)
+	{
+		ticks = INTERVAL_LOG_TICKS_MAX;
+	}
+	intervalLogTicks += ticks;
+	intervalLogPulses += pulses;
+
+	if(intervalLogTicks < INTERVAL_LOG_SLOT_TICKS)
+	{
+		return;
+	}
+
+	units = intervalLogTicks >> INTERVAL_LOG_TICK_SHIFT;
+	if(units > INTERVAL_LOG_UNITS_MAX)
+	{
+		units = INTERVAL_LOG_UNITS_MAX;
+	}
+	if(intervalLogPulses > INTERVAL_LOG_PULSES_MAX)
+	{
+		intervalLogPulses = INTERVAL_LOG_PULSES_MAX;
+	}
+
+	intervalLog[intervalLogSeq % INTERVAL_LOG_SIZE] = ((uint32_t)intervalLogPulses << INTERVAL_LOG_PULSE_SHIFT) | units;
+	intervalLogSeq++;
+	if(intervalLogFill < INTERVAL_LOG_SIZE)
+	{
+		intervalLogFill++;
+	}
+
+	intervalLogTicks &= (1 << INTERVAL_LOG_TICK_SHIFT) - 1;
+	intervalLogPulses = 0;
+}
+
+
+
+uint16_t intervalLogNextSeq()
+{
+	return intervalLogSeq;
+}
+
+
+
+uint16_t intervalLogOldestSeq(uint16_t seq)
+{
+	/*Unsigned 16 bit arithmetic, so this still works when the sequence number wraps*/
+	if( (uint16_t)(intervalLogSeq - seq) > intervalLogFill )
+	{
+		seq = intervalLogSeq - intervalLogFill;
+	}
+
+	return seq;
+}
+
+
+
+void intervalLogGet(uint16_t seq, uint16_t *pulses, uint32_t *ticks)
+{
+	uint32_t entry;
+
+	entry = intervalLog[seq % INTERVAL_LOG_SIZE];
+	*pulses = (uint16_t)(entry >> INTERVAL_LOG_PULSE_SHIFT);
+	*ticks = (entry & INTERVAL_LOG_UNITS_MAX) << INTERVAL_LOG_TICK_SHIFT;
+}
+
+
+
+void energyReset()
+{
+	energyKWh_x100 = 0;
+	energyRemainder = 0;
+}
+
+
+
+/*Load the energy register with the energy of a given number of pulses, when totalPulseCount
+is restored at boot. Done in two parts so pulses*100 can't overflow*/
+void energySetPulses(uint32_t pulses)
+{
+	uint32_t part;
+
+	part = (pulses % PULSES_PER_KWH)*100UL;
+	energyKWh_x100 = (pulses/PULSES_PER_KWH)*100 + part/PULSES_PER_KWH;
+	energyRemainder = (uint16_t)(part % PULSES_PER_KWH);
+}
+
+
+
+/*Each pulse is 1/PULSES_PER_KWH kWh, which is 100/PULSES_PER_KWH of a 0.01kWh step. Accumulating
+the numerator and carrying whole steps out of it keeps the energy register exact without dividing*/
+static void energyAddPulse()
+{
+	energyRemainder += 100;
+	if(energyRemainder >= PULSES_PER_KWH)
+	{
+		energyRemainder -= PULSES_PER_KWH;
+		energyKWh_x100++;
+	}
+}
+
+
+
+uint32_t energyKWhX100()
+{
+	return energyKWh_x100;
+}
+
+
+
+uint32_t powerKWX100()
+{
+	if( (intervalFill == 0) || (localTimerTicksSum == 0) )
+	{
+		return 0;
+	}
+
+	/*kW = KW_X100_TICKS/avg, and avg = localTimerTicksSum/intervalFill, so fold the two
+	together and only divide once*/
+	return (KW_X100_TICKS * intervalFill)/localTimerTicksSum;
+}
+
+
+
+/*Drain all the pulse timestamps queued by the capture ISR in one go. The queue means a pulse
+arriving while the main loop is busy elsewhere, e.g. waiting on a full UART transmit buffer, is
+held rather than overwriting the one before it*/
+uint8_t processPulse()
+{
+	uint32_t timestamp;
+	uint8_t lost;
+	uint32_t localTimerTicks;
+	PROFILE_BEGIN(PROF_PROCESS_PULSE);
+
+	windowComplete = FALSE;
+
+	while(pulseQueueGet(&timestamp, &lost))
+	{
+		localTimerTicks = timestamp - lastPulseTimestamp;
+		lastPulseTimestamp = timestamp;
+
+		if(lost)
+		{
+			/*The queue was full and some timestamps were dropped. The interval to this one spans
+			those pulses too so it can't be used for timing, but the energy is still counted.
+			Anything the glitch filter was holding back can't be resolved now, so count it too*/
+			if(filterPending)
+			{
+				acceptInterval(filterPending);
+				filterPending = 0;
+			}
+			filterCarry = 0;
+
+			totalPulseCount += (uint32_t)lost + 1;
+			intervalLogCount((uint16_t)lost + 1, localTimerTicks);
+			do
+			{
+				energyAddPulse();
+			}while(lost--);
+		}
+		else
+		{
+			processInterval(localTimerTicks);
+		}
+	}
+
+	PROFILE_END(PROF_PROCESS_PULSE);
+	return windowComplete;
+}
+
+
+
+void pulseFilterReset()
+{
+	filterFill = 0;
+	filterPending = 0;
+	filterCarry = 0;
+}
+
+
+
+void pulseRejectClear()
+{
+	uint8_t i;
+
+	for(i=0;i<REJECT_NUM_REASONS;i++)
+	{
+		pulseRejectCount[i] = 0;
+	}
+}
+
+
+
+static uint32_t median3(uint32_t a, uint32_t b, uint32_t c)
+{
+	if(a > b)
+	{
+		if(b > c)		return b;
+		else if(a > c)	return c;
+		else			return a;
+	}
+	else
+	{
+		if(a > c)		return a;
+		else if(b > c)	return c;
+		else			return b;
+	}
+}
+
+
+
+/*Glitch filter. Guards against EMI or a bouncing sensor putting an extra edge between two real
+pulses, which splits one real interval into two short ones.
+
+- An interval shorter than PULSE_FLOOR_TICKS can't be a real pulse at any load, it is rejected
+  outright and its time carried into the next interval.
+- Otherwise the interval is compared against the median of the last 3 accepted intervals, which
+  unlike the average isn't dragged down by a single short one. Anything shorter than
+  median/2^GLITCH_SHIFT is held back. If the next interval is normal and the held one is also
+  shorter than it/2^GLITCH_SHIFT the held edge is taken for a glitch, the two are merged back into
+  the one real interval and counted as one pulse. If the next one is short as well the load really
+  has stepped up, and both are counted. So are both if the held one isn't that short against the
+  next, as when the load steps up and then partly back down.
+
+The trade-off. A real pulse can't be told from a glitch by timing alone, so a single genuine
+interval that is short against both the ones before it and the one after, a brief load spike say,
+is merged away and that pulse's energy is lost. It costs at most one pulse per merge, and every
+merge is counted in pulseRejectCount[REJECT_DEVIATION] so it shows up*/
+static void processInterval(uint32_t localTimerTicks)
+{
+	uint32_t reference;
+
+	localTimerTicks += filterCarry;
+	filterCarry = 0;
+
+	if(localTimerTicks < PULSE_FLOOR_TICKS)
+	{
+		pulseRejectCount[REJECT_FLOOR]++;
+		filterCarry = localTimerTicks;
+		return;
+	}
+
+	if(filterFill >= 3)
+	{
+		reference = median3(filterHistory[0], filterHistory[1], filterHistory[2]);
+
+		if(localTimerTicks < (reference >> GLITCH_SHIFT))
+		{
+			if(filterPending == 0)
+			{
+				filterPending = localTimerTicks;
+				return;
+			}
+
+			/*Two short intervals in a row, the load has stepped up*/
+			acceptInterval(filterPending);
+			filterPending = 0;
+			acceptInterval(localTimerTicks);
+			return;
+		}
+	}
+
+	if(filterPending)
+	{
+		if(filterPending < (localTimerTicks >> GLITCH_SHIFT))
+		{
+			/*A short interval followed by a normal one, the edge in between was a glitch*/
+			pulseRejectCount[REJECT_DEVIATION]++;
+			localTimerTicks += filterPending;
+		}
+		else
+		{
+			/*Not short against the next one either, take it as a real change of load*/
+			acceptInterval(filterPending);
+		}
+		filterPending = 0;
+	}
+
+	acceptInterval(localTimerTicks);
+}
+
+
+
+static void acceptInterval(uint32_t localTimerTicks)
+{
+	/*TODO:DEBUG:RCC
+	**Track the minimum interval between external interrupts
+	*/
+	if(localTimerTicks < minTimerTicks)
+	{
+		minTimerTicks = localTimerTicks;
+	}
+
+	pulse_ticker++;
+	totalPulseCount++;
+	energyAddPulse();
+
+	intervalAvgUpdate(localTimerTicks);
+	intervalHistAdd(localTimerTicks);
+	intervalLogCount(1, localTimerTicks);
+
+	/*Keep the last 3 accepted intervals for the glitch filter reference*/
+	filterHistory[0] = filterHistory[1];
+	filterHistory[1] = filterHistory[2];
+	filterHistory[2] = localTimerTicks;
+	if(filterFill < 3)
+	{
+		filterFill++;
+	}
+
+	/*Count off the pulses in each averaging window. The averages themselves are kept up to
+	date on every pulse, see intervalAvgUpdate()*/
+	if( (pulse_ticker >= (uint8_t)averageWindow) )
+	{
+		pulse_ticker = 0;
+		windowComplete = TRUE;
+	}
+}
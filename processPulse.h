@@ -0,0 +1,168 @@
+#ifndef PROCESSPULSE_H
+#define PROCESSPULSE_H
+/************************************************************************
+Title:    External pulse processing
+Author:   Richard Clarke <richard@clarke.biz>
+File:     $Id:  $
+Software: AVR-GCC 4.1, AVR Libc 1.4
+Hardware: ATMega328P
+License:  GNU General Public License
+
+LICENSE:
+    Copyright (C) 2009 Richard Clarke
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+************************************************************************/
+#include <inttypes.h>
+
+#include "global.h"
+
+#define PULSES_PER_KWH (uint16_t)1600
+#define TIMER_TICK_RATE 3600 /*per second, determined by F_CPU and TIMER_CLK_DIV1024*/
+
+/*Instantaneous power is 3600/(PULSES_PER_KWH*interval_sec) kW. With the interval in Timer1
+ticks and the result in kW x 100 this is KW_X100_TICKS/ticks, worked out here at compile time*/
+#define KW_X100_TICKS ((100UL * 3600UL * TIMER_TICK_RATE)/PULSES_PER_KWH)
+
+/*Shortest interval that could be a real pulse. Anything shorter is rejected whatever the
+recent intervals have been. 36 ticks is 10ms, which would be a load of 225kW*/
+#define PULSE_FLOOR_TICKS	36
+
+/*An interval shorter than 1/2^GLITCH_SHIFT of the median of the last 3 accepted intervals
+is suspected of being a glitch, and merged away if it is that short against the next one too*/
+#define GLITCH_SHIFT		2
+
+/*Reasons for the glitch filter rejecting an interval, index into pulseRejectCount[]*/
+enum pulseReject_t
+{
+	REJECT_FLOOR,			/*shorter than PULSE_FLOOR_TICKS*/
+	REJECT_DEVIATION,		/*short compared with the recent intervals and the one after, merged
+							into the one after. Costs a real pulse if it wasn't a glitch*/
+	REJECT_NUM_REASONS
+};
+
+extern uint16_t pulseRejectCount[REJECT_NUM_REASONS];
+
+/*Interval histogram, INTERVAL_HIST_BINS octave wide bins starting at 2^INTERVAL_HIST_LOG2_MIN
+ticks. With 1600 pulses/kWh bin 0 is 256 to 511 ticks (above 15.8kW), bin 5 is 0.49 to 0.99kW
+and bin 15 catches everything below about 1W*/
+#define INTERVAL_HIST_BINS		16
+#define INTERVAL_HIST_LOG2_MIN	8
+
+/*The interval log keeps the pulses counted and the time they took over slots of at least
+INTERVAL_LOG_SLOT_SECS. A slot is closed by the first pulse at or after that time, so it covers
+whole intervals and the power worked out from it is exact. However high the load, no slot is
+shorter than INTERVAL_LOG_SLOT_SECS, so the log always holds INTERVAL_LOG_SIZE x
+INTERVAL_LOG_SLOT_SECS at least, 64 minutes with the defaults. At low loads slots stretch to the
+next pulse and the log covers longer.
+
+Number of slots kept, each costs 4 bytes of SRAM. Must be a power of 2 so the 16 bit sequence
+number can wrap without a jump in the log position*/
+#ifndef INTERVAL_LOG_SIZE
+#define INTERVAL_LOG_SIZE		128
+#endif
+#ifndef INTERVAL_LOG_SLOT_SECS
+#define INTERVAL_LOG_SLOT_SECS	30
+#endif
+#define INTERVAL_LOG_SLOT_TICKS	((uint32_t)INTERVAL_LOG_SLOT_SECS * TIMER_TICK_RATE)
+
+#if (INTERVAL_LOG_SIZE & (INTERVAL_LOG_SIZE - 1))
+#error INTERVAL_LOG_SIZE is not a power of 2
+#endif
+
+/*Entries pack the pulses in the slot into the top 12 bits and the time into the other 20, in
+units of 2^INTERVAL_LOG_TICK_SHIFT ticks. The time saturates at about 19.4 minutes, a slot
+only gets that long below an average of about 2W*/
+#define INTERVAL_LOG_PULSE_SHIFT	20
+#define INTERVAL_LOG_PULSES_MAX		0x0FFFU
+#define INTERVAL_LOG_TICK_SHIFT		2
+#define INTERVAL_LOG_UNITS_MAX		0x000FFFFFUL
+#define INTERVAL_LOG_TICKS_MAX		(INTERVAL_LOG_UNITS_MAX << INTERVAL_LOG_TICK_SHIFT)
+
+/*A slot can't hold more pulses than there are bits for, even with every interval at the floor*/
+#if ((INTERVAL_LOG_SLOT_SECS * TIMER_TICK_RATE) / PULSE_FLOOR_TICKS + 1) > INTERVAL_LOG_PULSES_MAX
+#error INTERVAL_LOG_SLOT_SECS is too long for the pulses a slot can count
+#endif
+
+/*Longest boxcar averaging window that can be selected with the SW command, in pulses.
+Each pulse in the window costs 4 bytes of SRAM*/
+#define AVG_WINDOW_MAX		16
+
+/*The exponential average is kept in fixed point with this many fractional bits, so that
+small alpha values don't lose the interval changes to truncation*/
+#define EMA_FRAC_BITS		4
+
+/*Range of the exponential average smoothing shift, alpha = 1/2^emaShift*/
+#define EMA_SHIFT_MIN		1
+#define EMA_SHIFT_MAX		8
+#define EMA_SHIFT_DEFAULT	3
+
+
+/*Set the timing reference for the first pulse interval*/
+extern void processPulseInit(void);
+
+/*Drain the pulse queue and update the measurements. Call from the main loop. Returns TRUE if
+an averaging window was completed, i.e. there are new measurements to report*/
+extern uint8_t processPulse(void);
+
+/*************************************************************************
+Function: intervalAvgReset()
+Purpose:  discard the history held by both interval averages. Must be called
+		  whenever averageWindow is changed.
+**************************************************************************/
+extern void intervalAvgReset(void);
+
+/*Boxcar average of the last averageWindow pulse intervals, in Timer1 ticks. Kept up to date
+on every pulse, the division is only done when the value is asked for*/
+extern uint32_t intervalAvgTicks(void);
+
+/*Exponential average of the pulse interval, in Timer1 ticks*/
+extern uint32_t intervalEmaTicks(void);
+
+/*Forget the glitch filter history*/
+extern void pulseFilterReset(void);
+
+/*Clear the glitch filter rejection counters*/
+extern void pulseRejectClear(void);
+
+/*Read one bin of the interval histogram, and clear the whole histogram*/
+extern uint16_t intervalHistGet(uint8_t bin);
+extern void intervalHistClear(void);
+
+/*************************************************************************
+Interval log, a summary of each completed slot (pulses in the slot and the time they took, in
+Timer1 ticks) tagged with a 16 bit sequence number. A collector remembers the sequence number after the
+last entry it has, and asks for everything from there on when it next polls.
+
+intervalLogNextSeq()   sequence number the next slot to complete will get
+intervalLogOldestSeq() seq, or the oldest sequence number still held if seq has been overwritten
+intervalLogGet()       read the entry for seq, which must lie between the two above
+**************************************************************************/
+extern uint16_t intervalLogNextSeq(void);
+extern uint16_t intervalLogOldestSeq(uint16_t seq);
+extern void intervalLogGet(uint16_t seq, uint16_t *pulses, uint32_t *ticks);
+
+/*Clear the energy register, along with totalPulseCount*/
+extern void energyReset(void);
+
+/*Set the energy register to the energy of a given number of pulses*/
+extern void energySetPulses(uint32_t pulses);
+
+/*Energy consumed since the last reset, kWh x 100*/
+extern uint32_t energyKWhX100(void);
+
+/*Instantaneous power from the boxcar average interval, kW x 100. This is the only division
+in the power and energy calculations and is only done when the value is reported*/
+extern uint32_t powerKWX100(void);
+
+
+#endif
@@ -0,0 +1,87 @@
+//
+// profiler.c
+//
+// Count, total, minimum and maximum run time of each profiled
+// region, timed on Timer0. Compiled out unless PROFILE_ENABLE is set.
+//
+// Author: Richard C Clarke
+// Date: March 2009
+//
+
+
+// includes
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include <inttypes.h>
+
+#include "global.h"
+#include "timer.h"
+#include "profiler.h"
+
+#if PROFILE_ENABLE
+
+static struct profileStats_t profileStats[PROF_NUM_REGIONS];
+
+
+
+void profileRecord(uint8_t region, uint16_t ticks)
+{
+	struct profileStats_t *stats;
+
+	stats = &profileStats[region];
+
+	stats->count++;
+	if( (MAX_U32 - stats->total) >= ticks )
+	{
+		stats->total += ticks;
+	}
+	else
+	{
+		stats->total = MAX_U32;
+	}
+	if(ticks < stats->min)
+	{
+		stats->min = ticks;
+	}
+	if(ticks > stats->max)
+	{
+		stats->max = ticks;
+	}
+}
+
+
+
+/*The counters of the ISR regions are updated under interrupt, so both of these work with
+interrupts off*/
+void profileGet(uint8_t region, struct profileStats_t *stats)
+{
+	u08 sreg;
+
+	sreg = SREG;
+	cli();
+	*stats = profileStats[region];
+	SREG = sreg;
+}
+
+
+
+void profileClear()
+{
+	u08 sreg;
+	uint8_t i;
+
+	sreg = SREG;
+	cli();
+	for(i=0;i<PROF_NUM_REGIONS;i++)
+	{
+		profileStats[i].count = 0;
+		profileStats[i].total = 0;
+		profileStats[i].min = MAX_U16;
+		profileStats[i].max = 0;
+	}
+	SREG = sreg;
+}
+
+#endif
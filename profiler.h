@@ -0,0 +1,85 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+/************************************************************************
+Title:    Run time profiling of interrupt handlers and hot functions
+Author:   Richard Clarke <richard@clarke.biz>
+File:     $Id:  $
+Software: AVR-GCC 4.1, AVR Libc 1.4
+Hardware: ATMega328P
+License:  GNU General Public License
+
+LICENSE:
+    Copyright (C) 2009 Richard Clarke
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+************************************************************************/
+#include <inttypes.h>
+
+#include "global.h"
+#include "timer.h"
+
+/*Build with PROFILE_ENABLE set to 1 to time the regions below. Otherwise PROFILE_BEGIN() and
+PROFILE_END() are empty and there are no counters or commands, the build is as if they weren't
+there*/
+#ifndef PROFILE_ENABLE
+#define PROFILE_ENABLE		0
+#endif
+
+/*Regions timed, index into the profile counters*/
+enum profileRegion_t
+{
+	PROF_PULSE_ISR,			/*INT0 or ICP1 pulse edge*/
+	PROF_UART_RX_ISR,		/*UART receive complete, including the command framing*/
+	PROF_UART_UDRE_ISR,		/*UART data register empty*/
+	PROF_PROCESS_PULSE,		/*processPulse()*/
+	PROF_REPORT_RENDER,		/*reportUpdate() when it renders*/
+	PROF_REPORT_SEND,		/*reportSend()*/
+	PROF_NUM_REGIONS
+};
+
+/*Counters for one region. Times are in Timer0 ticks of 64 clocks, so Timer0 must be running,
+main() starts it with timer0Init() before anything is timed. A region is timed from a
+random point within the tick it starts in, so total/count is the mean time without bias even
+for regions far shorter than a tick, while min and max are only good to a tick. Regions in
+the main loop include the time spent in any interrupts that arrive while they run*/
+struct profileStats_t
+{
+	uint32_t count;
+	uint32_t total;			/*saturates rather than wrapping*/
+	uint16_t min;
+	uint16_t max;
+};
+
+#if PROFILE_ENABLE
+
+/*PROFILE_BEGIN() and PROFILE_END() bracket a region, within one block. The time stamp is a
+function call, so an ISR that is profiled saves the call-clobbered registers on entry*/
+#define PROFILE_BEGIN(region)	uint16_t profileStart_##region = timer0GetTimestamp()
+#define PROFILE_END(region)		profileRecord(region, timer0GetTimestamp() - profileStart_##region)
+
+/*Add one timing of region to its counters. Each region must only ever be timed from one
+context, main loop or interrupt, they aren't protected against each other*/
+extern void profileRecord(uint8_t region, uint16_t ticks);
+
+/*Read the counters of one region, and clear them all*/
+extern void profileGet(uint8_t region, struct profileStats_t *stats);
+extern void profileClear(void);
+
+#else
+
+#define PROFILE_BEGIN(region)
+#define PROFILE_END(region)
+
+#endif
+
+
+#endif
@@ -0,0 +1,427 @@
+//
+// pulseCapture.c
+//
+// Timestamping of the external power meter LED pulses. Hands the
+// interval between successive pulses to processPulse().
+//
+// Author: Richard C Clarke
+// Date: March 2009
+//
+
+
+// includes
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include <inttypes.h>
+
+#include "global.h"
+#include "timer.h"
+#include "pulseCapture.h"
+#include "profiler.h"
+
+
+/*Timer1 overflow counter maintained by the TIMER1_OVF_vect handler in timer.c*/
+extern volatile unsigned long Timer1Reg0;
+
+/*Single producer, single consumer ring of pulse timestamps. Only the capture ISR writes
+pulseQueueHead and only processPulse() (via pulseQueueGet()) writes pulseQueueTail. Both are
+single bytes, so each side can read the other's index without disabling interrupts. One slot is
+always left empty to tell a full ring from an empty one*/
+static volatile struct pulseQueueEntry_t pulseQueue[PULSE_QUEUE_SIZE];
+static volatile uint8_t pulseQueueHead;
+static volatile uint8_t pulseQueueTail;
+
+/*Number of pulses lost since the last successful push, handed on with the next entry*/
+static uint8_t pulseQueueLost;
+
+/*Diagnostics, total pulses lost to a full ring and the most entries ever waiting at once*/
+static volatile uint16_t pulseQueueOverflows;
+static volatile uint8_t pulseQueueHighWater;
+
+#if PULSE_WIDTH_QUALIFY
+/*Pulse width qualification. The rise time is held until the falling edge shows whether the pulse
+was wide enough, and narrow enough, to have come from the meter LED*/
+static uint32_t pulseRiseTimestamp;
+static uint16_t pulseRiseCount;
+static BOOL pulseHigh;
+
+/*Accepted pulse width window, in Timer1 ticks*/
+static volatile uint16_t pulseWidthMin;
+static volatile uint16_t pulseWidthMax;
+
+/*Histogram of every pulse width seen, accepted or not, and count of those rejected*/
+static volatile uint16_t pulseWidthHist[PULSE_WIDTH_HIST_BINS];
+static volatile uint16_t pulseWidthRejects;
+#endif
+
+
+
+void pulseCaptureInit(void)
+{
+	/*Timer1 in normal mode, counting freely from 0 to 0xFFFF*/
+	TCCR1A = 0;
+
+	pulseQueueHead = 0;
+	pulseQueueTail = 0;
+	pulseQueueLost = 0;
+	pulseQueueOverflows = 0;
+	pulseQueueHighWater = 0;
+
+#if PULSE_WIDTH_QUALIFY
+	pulseHigh = FALSE;
+	pulseWidthMin = PULSE_WIDTH_MIN_DEFAULT;
+	pulseWidthMax = PULSE_WIDTH_MAX_DEFAULT;
+	pulseWidthHistClear();
+#endif
+
+#if (PULSE_CAPTURE_MODE == PULSE_CAPTURE_ICP1)
+
+	/*Configure PB0 (ICP1) as input with weak pull up*/
+	cbi(DDRB, PB0);
+	sbi(PORTB, PB0);
+
+	/*Capture on rising edge, with the 4 cycle noise canceler switched in*/
+	TCCR1B |= _BV(ICES1) | _BV(ICNC1);
+
+#if !TIMER_STATIC_DISPATCH
+	timerAttach(TIMER1INPUTCAPTURE_INT, pulseCaptureService);
+#endif
+
+	/*Clear any stale capture before enabling the interrupt*/
+	TIFR1 = _BV(ICF1);
+	sbi(TIMSK1, ICIE1);
+
+#else
+
+#if PULSE_WIDTH_QUALIFY
+	// External Interrupt Control Register A,
+	//interrupt on any change of the INT0 pin, to time both edges of the pulse
+	EICRA = (1<<ISC00);
+#else
+	// External Interrupt Control Register A,
+	//interrupt on INT0 pin rising edge (sensor triggered)
+  	EICRA = (1<<ISC01) | (1<<ISC00);
+#endif
+
+  	// turn on external interrupt 0, PD2 on ATMega328P, Pin 4, (D0, Pin 15 on DT107a SIMMBUS connector)
+	EIFR = _BV(INTF0);
+  	EIMSK  = _BV(INT0);
+
+#endif
+}
+
+
+
+/*Extend a 16 bit Timer1 value latched at an edge to 32 bits with the Timer1 overflow count.
+Called from ISR context, so the overflow ISR can't run in the meantime. If an overflow is pending
+and the latched value is small, TCNT1 wrapped before the edge and the overflow hasn't been counted
+yet. A large latched value with an overflow pending was latched before the wrap*/
+static inline uint32_t pulseCaptureExtend(uint16_t count)
+{
+	uint16_t overflows;
+
+	overflows = (uint16_t)Timer1Reg0;
+	if( (TIFR1 & _BV(TOV1)) && (count < 0x8000) )
+	{
+		overflows++;
+	}
+
+	return ((uint32_t)overflows << 16) | count;
+}
+
+
+
+/*Queue the pulse time for processPulse(). If the main loop has fallen so far behind that
+the ring is full the timestamp is dropped, but the pulse itself is still accounted for by tagging
+the next entry that does fit*/
+static inline void pulseQueuePush(uint32_t timestamp)
+{
+	uint8_t tmphead;
+	uint8_t used;
+
+	tmphead = (pulseQueueHead + 1) & PULSE_QUEUE_MASK;
+
+	if(tmphead == pulseQueueTail)
+	{
+		pulseQueueOverflows++;
+		if(pulseQueueLost < MAX_U08)
+		{
+			pulseQueueLost++;
+		}
+		return;
+	}
+
+	pulseQueue[tmphead].timestamp = timestamp;
+	pulseQueue[tmphead].lost = pulseQueueLost;
+	pulseQueueLost = 0;
+
+	/*Publish the entry only once it has been completely written*/
+	pulseQueueHead = tmphead;
+
+	used = (tmphead - pulseQueueTail) & PULSE_QUEUE_MASK;
+	if(used > pulseQueueHighWater)
+	{
+		pulseQueueHighWater = used;
+	}
+}
+
+
+
+/*Handle an edge on the pulse input, with count the Timer1 value latched at the edge and high
+TRUE for a rising edge. The pulse is timestamped by its rising edge*/
+static inline void pulseCaptureEdge(uint16_t count, uint8_t high)
+{
+#if PULSE_WIDTH_QUALIFY
+	uint16_t width;
+	uint8_t bin;
+
+	if(high)
+	{
+		pulseRiseTimestamp = pulseCaptureExtend(count);
+		pulseRiseCount = count;
+		pulseHigh = TRUE;
+	}
+	else if(pulseHigh)
+	{
+		pulseHigh = FALSE;
+		width = count - pulseRiseCount;
+
+		bin = (width >> PULSE_WIDTH_HIST_SHIFT) < PULSE_WIDTH_HIST_BINS ?
+				(width >> PULSE_WIDTH_HIST_SHIFT) : (PULSE_WIDTH_HIST_BINS - 1);
+		if(pulseWidthHist[bin] < MAX_U16)
+		{
+			pulseWidthHist[bin]++;
+		}
+
+		if( (width >= pulseWidthMin) && (width <= pulseWidthMax) )
+		{
+			pulseQueuePush(pulseRiseTimestamp);
+		}
+		else if(pulseWidthRejects < MAX_U16)
+		{
+			pulseWidthRejects++;
+		}
+	}
+#else
+	if(high)
+	{
+		pulseQueuePush(pulseCaptureExtend(count));
+	}
+#endif
+}
+
+
+
+uint8_t pulseQueueGet(uint32_t *timestamp, uint8_t *lost)
+{
+	uint8_t tmptail;
+
+	if(pulseQueueHead == pulseQueueTail)
+	{
+		return FALSE;
+	}
+
+	tmptail = (pulseQueueTail + 1) & PULSE_QUEUE_MASK;
+	*timestamp = pulseQueue[tmptail].timestamp;
+	*lost = pulseQueue[tmptail].lost;
+
+	/*Hand the slot back to the ISR only once it has been read*/
+	pulseQueueTail = tmptail;
+
+	return TRUE;
+}
+
+
+
+uint8_t pulseQueueAvailable(void)
+{
+	return (pulseQueueHead != pulseQueueTail);
+}
+
+
+
+void pulseQueueGetStats(uint16_t *overflows, uint8_t *highWater)
+{
+	uint8_t sreg;
+
+	sreg = SREG;
+	cli();
+	*overflows = pulseQueueOverflows;
+	*highWater = pulseQueueHighWater;
+	SREG = sreg;
+}
+
+
+
+void pulseQueueClearStats(void)
+{
+	uint8_t sreg;
+
+	sreg = SREG;
+	cli();
+	pulseQueueOverflows = 0;
+	pulseQueueHighWater = 0;
+	SREG = sreg;
+}
+
+
+
+#if PULSE_WIDTH_QUALIFY
+
+uint8_t pulseWidthSetMin(uint16_t ticks)
+{
+	uint8_t sreg;
+
+	if(ticks > pulseWidthMax)
+	{
+		return FALSE;
+	}
+
+	sreg = SREG;
+	cli();
+	pulseWidthMin = ticks;
+	SREG = sreg;
+
+	return TRUE;
+}
+
+
+
+uint8_t pulseWidthSetMax(uint16_t ticks)
+{
+	uint8_t sreg;
+
+	if(ticks < pulseWidthMin)
+	{
+		return FALSE;
+	}
+
+	sreg = SREG;
+	cli();
+	pulseWidthMax = ticks;
+	SREG = sreg;
+
+	return TRUE;
+}
+
+
+
+uint16_t pulseWidthGetMin(void)
+{
+	return pulseWidthMin;
+}
+
+
+
+uint16_t pulseWidthGetMax(void)
+{
+	return pulseWidthMax;
+}
+
+
+
+uint16_t pulseWidthHistGet(uint8_t bin)
+{
+	uint16_t count;
+	uint8_t sreg;
+
+	sreg = SREG;
+	cli();
+	if(bin < PULSE_WIDTH_HIST_BINS)
+	{
+		count = pulseWidthHist[bin];
+	}
+	else
+	{
+		count = pulseWidthRejects;
+	}
+	SREG = sreg;
+
+	return count;
+}
+
+
+
+void pulseWidthHistClear(void)
+{
+	uint8_t i;
+	uint8_t sreg;
+
+	sreg = SREG;
+	cli();
+	for(i=0;i<PULSE_WIDTH_HIST_BINS;i++)
+	{
+		pulseWidthHist[i] = 0;
+	}
+	pulseWidthRejects = 0;
+	SREG = sreg;
+}
+
+#endif
+
+
+
+#if (PULSE_CAPTURE_MODE == PULSE_CAPTURE_ICP1)
+
+/*Input capture on ICP1. ICR1 holds the value TCNT1 had when the edge arrived, so it doesn't
+matter how long it took to get here*/
+#if TIMER_STATIC_DISPATCH
+static inline void pulseCaptureService(void)
+#else
+void pulseCaptureService(void)
+#endif
+{
+#if PULSE_WIDTH_QUALIFY
+	uint8_t rising;
+#endif
+	PROFILE_BEGIN(PROF_PULSE_ISR);
+
+#if PULSE_WIDTH_QUALIFY
+	/*ICES1 says which edge this capture was for. Flip it to catch the other edge next,
+	changing ICES1 can set ICF1 so clear it afterwards*/
+	rising = TCCR1B & _BV(ICES1);
+	TCCR1B ^= _BV(ICES1);
+	TIFR1 = _BV(ICF1);
+
+	pulseCaptureEdge(ICR1, rising);
+#else
+	pulseCaptureEdge(ICR1, TRUE);
+#endif
+	WAKE_MARK(WAKE_PULSE);
+	PROFILE_END(PROF_PULSE_ISR);
+}
+
+#if TIMER_STATIC_DISPATCH
+/*Timer1 input capture, bound here rather than through timerAttach() so the service routine is
+inlined and the ISR only saves the registers it uses*/
+ISR(TIMER1_CAPT_vect)
+{
+	pulseCaptureService();
+}
+#endif
+
+#else
+
+/*External pulse interrupt on PD2*/
+ISR(INT0_vect)
+{
+	uint16_t count;
+
+	/*Read TCNT1 as early as possible, the interval measured is only as good as the
+	latency of getting here*/
+	count = TCNT1;
+	PROFILE_BEGIN(PROF_PULSE_ISR);
+
+#if PULSE_WIDTH_QUALIFY
+	/*INT0 triggers on both edges, the pin level says which one this was*/
+	pulseCaptureEdge(count, PIND & _BV(PD2));
+#else
+	pulseCaptureEdge(count, TRUE);
+#endif
+	WAKE_MARK(WAKE_PULSE);
+	PROFILE_END(PROF_PULSE_ISR);
+}
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef PULSECAPTURE_H
+#define PULSECAPTURE_H
+/************************************************************************
+Title:    Power meter LED pulse capture
+Author:   Richard Clarke <richard@clarke.biz>
+File:     $Id:  $
+Software: AVR-GCC 4.1, AVR Libc 1.4
+Hardware: ATMega328P
+License:  GNU General Public License
+
+LICENSE:
+    Copyright (C) 2009 Richard Clarke
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+************************************************************************/
+#include <inttypes.h>
+
+#include "global.h"
+#include "timer.h"
+
+/*Pulse capture sources.
+
+PULSE_CAPTURE_INT0 - the LED pulse detector drives INT0 (PD2) and the edge is timestamped in
+software by reading TCNT1 on entry to the INT0 ISR. Any ISR entry latency, or time spent in the
+UART ISRs before INT0 gets serviced, shows up as jitter in the measured interval.
+
+PULSE_CAPTURE_ICP1 - the LED pulse detector drives ICP1 (PB0) and the Timer1 input capture unit
+latches TCNT1 into ICR1 in hardware at the edge. The measured interval is then tick exact no matter
+what else the AVR is doing when the edge arrives.
+
+In both modes Timer1 is left free running and the interval is the difference between successive
+edge timestamps, so nothing is lost by zeroing TCNT1 part way through a tick. The timestamps are
+extended to 32 bits with the Timer1 overflow count, so intervals longer than 65535 ticks (18.2 sec)
+no longer wrap*/
+#define PULSE_CAPTURE_INT0		0
+#define PULSE_CAPTURE_ICP1		1
+
+#ifndef PULSE_CAPTURE_MODE
+#define PULSE_CAPTURE_MODE		PULSE_CAPTURE_INT0
+#endif
+
+
+/*************************************************************************
+Function: pulseCaptureInit()
+Purpose:  configure the selected pulse capture source and enable its interrupt.
+		  Timer1 must already be running with the required prescaler.
+**************************************************************************/
+extern void pulseCaptureInit(void);
+
+/*Pulse width qualification. The LED on the meter emits a fixed width pulse, so when enabled
+both edges of each pulse are timed and the pulse is only passed on to processPulse() if its
+width lies between pulseWidthMin and pulseWidthMax. Most EMI spikes are far narrower than a
+real pulse and get rejected here, before they ever reach the interval measurements*/
+#ifndef PULSE_WIDTH_QUALIFY
+#define PULSE_WIDTH_QUALIFY		1
+#endif
+
+/*Default accepted pulse width window, in Timer1 ticks (1/3600 sec). Set with the SN and SX
+commands to suit the meter*/
+#define PULSE_WIDTH_MIN_DEFAULT	4		/*1.1ms*/
+#define PULSE_WIDTH_MAX_DEFAULT	1800	/*0.5 sec*/
+
+/*Pulse width histogram, PULSE_WIDTH_HIST_BINS bins each 2^PULSE_WIDTH_HIST_SHIFT ticks wide.
+The last bin also counts everything wider. The defaults cover 0 to 142ms in 8.9ms steps*/
+#define PULSE_WIDTH_HIST_BINS	16
+#define PULSE_WIDTH_HIST_SHIFT	5
+
+/*Number of pulse timestamps that can be waiting for processPulse(). Must be a power of 2,
+one slot is always kept empty. At the 20kW maximum rate of about 9 pulses/sec the default
+covers the main loop being stalled for around 3/4 sec*/
+#ifndef PULSE_QUEUE_SIZE
+#define PULSE_QUEUE_SIZE		8
+#endif
+#define PULSE_QUEUE_MASK		(PULSE_QUEUE_SIZE - 1)
+
+#if (PULSE_QUEUE_SIZE & PULSE_QUEUE_MASK)
+#error PULSE_QUEUE_SIZE is not a power of 2
+#endif
+
+struct pulseQueueEntry_t
+{
+	uint32_t timestamp;		/*32 bit extended Timer1 value at the pulse edge*/
+	uint8_t lost;			/*pulses dropped because the queue was full, just before this one*/
+};
+
+
+/*************************************************************************
+Function: pulseQueueGet()
+Purpose:  take the oldest pulse timestamp off the queue. Only to be called from
+		  the main loop, never from an ISR.
+Arguments: timestamp, where to put the extended Timer1 value at the edge
+		   lost, where to put the number of pulses dropped just before this one
+Returns:  TRUE if an entry was returned, FALSE if the queue is empty
+**************************************************************************/
+extern uint8_t pulseQueueGet(uint32_t *timestamp, uint8_t *lost);
+
+/*Returns TRUE if there are pulse timestamps waiting to be processed*/
+extern uint8_t pulseQueueAvailable(void);
+
+/*Read and clear the queue overflow and high watermark counters*/
+extern void pulseQueueGetStats(uint16_t *overflows, uint8_t *highWater);
+extern void pulseQueueClearStats(void);
+
+#if PULSE_WIDTH_QUALIFY
+/*Set the accepted pulse width window, in Timer1 ticks. Return FALSE and leave the window
+unchanged if the new limit would put the minimum above the maximum*/
+extern uint8_t pulseWidthSetMin(uint16_t ticks);
+extern uint8_t pulseWidthSetMax(uint16_t ticks);
+extern uint16_t pulseWidthGetMin(void);
+extern uint16_t pulseWidthGetMax(void);
+
+/*Read one bin of the pulse width histogram. Bin PULSE_WIDTH_HIST_BINS reads the number of
+pulses rejected for being outside the width window*/
+extern uint16_t pulseWidthHistGet(uint8_t bin);
+extern void pulseWidthHistClear(void);
+#endif
+
+#if (PULSE_CAPTURE_MODE == PULSE_CAPTURE_ICP1) && !TIMER_STATIC_DISPATCH
+/*Timer1 input capture service routine, attached to TIMER1INPUTCAPTURE_INT. With
+TIMER_STATIC_DISPATCH it is private to pulseCapture.c, inlined into the ISR there*/
+extern void pulseCaptureService(void);
+#endif
+
+
+#endif
@@ -1,426 +1,1182 @@
-//
-// pwrmonNode_main.c
-//
-// The main file containing the kernel of the Smart Power Monitor 
-// Remote Node.
-//
-// Author: Richard C Clarke
-// Date: March 2009
-//
-
-
-// includes
-
-#include <stdlib.h>
-#include <avr/io.h>
-#include <avr/pgmspace.h>
-
-#include <avr/interrupt.h>
-#include <avr/sleep.h>
-#include <inttypes.h>
-
-#include "global.h"
-#include "timer.h"
-
-#include "uart.h"		// include uart function library
-#include "serialcommand_rcc.h"
-
-//u08 UART_NL[] = {0x0d,0x0a,0};
-
-#define SMALL_MEMORY 0
-#define DEBUG_SERIAL 1
-
-
-// defines
-#define LED_DDR  DDRD
-#define LED_PORT PORTD
-#define LED_PIN  PIND
-#define LED1     PIND3
-
-
-/*INT0 is on PORTD, PD2*/
-#define PULSE_INT DDRD
-
-#define UPDATE_RATE 10
-
-//#define F_CPU 8000000
-#define UART_BAUD_RATE      9600 
-
-
-/*#####################################
-** Command Flag definitions, bit position
-*/
-#define ON_CHANGE 0
-#define ON_QUERY 1
-#define SEND_TOTAL_COUNT 2
-
-
-
-
-/*Prototype*/
-void myTimer1IntHandler(void);
-void debugInfoOut(void);
-void debugCSVInfoOut(void);
-void sendTotalCount();
-void ports_init(void);
-void processPulse();
-
-
-extern volatile unsigned char serCmndReady;
-
-
-
-/*Global volatile variables, modifiable by ISR's. Volatile variables larger than 1 byte must be
-read and written in one atomic operation. Interrupts must either be disabled or a local copy made
-of the volatile variable before using it in an operation*/
-volatile BOOL timerRollOverFlag;
-volatile BOOL externalPulseFlag; 
-volatile uint16_t thisTimer1Count;
-//uint16_t localTimerTicks;
-
-/*For Debug, keep track of the minimum duration seen on PD2 between external interrupts.
-This number is in terms of number of ticks of a counter being incremented at the rate of 
-3600Hz*/
-uint16_t minTimerTicks;
-
-//uint16_t tickRate_Hz;
-uint16_t prescaleDiv;
-uint16_t timerVal;
-//uint32_t pulse_interval_sum;
-uint32_t localTimerTicksSum;
-uint16_t localTimerTicksAvg;
-
-/*The number of LED pulses between sending latest measurements out serial port*/
-uint8_t averageWindow;
-uint16_t pulse_ticker;
-uint16_t minTickError;
-
-
-/*Keeps track of the total number of pulses counted since last reset or variable clear command*/
-uint32_t totalPulseCount;
-
-char buffer[12];
-
-//
-// main function
-//
-int main(void) 
-{
-
-
-	
-	uint16_t tickRate_Hz;
-	uint8_t commandCode[2];
-	uint16_t cmdValue;
-	uint8_t measureDataChange;
-	uint8_t commandFlags;
-	uint8_t commandLength;
-
-		
-
-	ports_init();
-
-	// initialize our libraries
-	/*
-     *  Initialize UART library, pass baudrate and AVR cpu clock
-     *  with the macro 
-     *  UART_BAUD_SELECT() (normal speed mode )
-     *  or 
-     *  UART_BAUD_SELECT_DOUBLE_SPEED() ( double speed mode)
-     */
-    //uart_init( UART_BAUD_SELECT(UART_BAUD_RATE,F_CPU) ); 
-	uart_init(UART_BAUD_RATE);
-
-	// initialize the timer system, enables global interrupts.
-	
-	//timer1Init();
-	/*Timer clocked at F_CPU/1024*/
-
-	timer1SetPrescaler(TIMER_CLK_DIV1024);
-	cbi(TIMSK1, TOIE1);						// disable TCNT1 overflow
-	//timerAttach(1, myTimer1IntHandler );
-
-	timerRollOverFlag = 0;
-	externalPulseFlag = 0;
-	/*Counts the pulses from the LED pulse detector, after every 160 increment the 
-	0.1 decimal KWh counter*/
-	pulse_ticker = 0;
-
-	averageWindow = UPDATE_RATE;
-	measureDataChange = 0;
-	commandFlags = 0;
-	totalPulseCount = 0;
-	minTimerTicks = 65535; /*Equiv to 65535/3600 = 18.204 sec*/
-	localTimerTicksSum = 0;
-	minTickError = 0;
-
-
-	/*********************************************
-	* Test Timer Ticks to Millisecond Calculation
-	**********************************************/
-	/*Result here is time in milliseconds x 10, to give 0.1ms resolution
-	in the calculation, otherwise can only represent times to integer numbers
-	of 1ms increments*/
-	tickRate_Hz = (F_CPU/timer1GetPrescaler());
-
-	
-	// enable global interrupts
-	sei();
-
-	/*
-     *  Transmit string to UART
-     *  The string is buffered by the uart library in a circular buffer
-     *  and one character at a time is transmitted to the UART using interrupts.
-     *  uart_puts() blocks if it can not write the whole string to the circular 
-     *  buffer
-     */
-    
-    /*
-     * Transmit string from program memory to UART
-     */
-    uart_puts_P("PowerMeterMonitor\r\n");
-	
-
-	/*CSV Column headings*/
-	uart_puts_P("(totalCount,Avged Interval, Min Interval)\r\n");
-    
-  
-
-	/*Main kernel loop*/
-	while(1) 	    /* Forever */
-	{
-		/*Check to see if we've received a command character from serial port
-		May need to implement a command processing state machine eventually*/
-		//commandChar = uart_getc();
-		if (serCmndReady)
-		{
-			/*Process the Command, for now just send out the total measurement counts*/
-			commandLength = sc_getCmd();
-
-			if( sc_validateCmd(&commandCode[0], &cmdValue) == CMD_VALID )
-			{
-				
-
-				//ultoa( cmdValue, buffer, 10);
-				//uart_puts(buffer);
-				/*For the moment if we receive a command conforming to the required format then
-				send a string containing current measurement results*/
-				//sendTotalCount();
-
-				/*if(commandCode[0] == 'S')
-				{
-					uart_putc(commandCode[1]);
-				}*/
-
-			}
-			else
-			{
-				/*Make sure nothing happens*/
-				//ultoa( commandLength, buffer, 10);
-				//uart_puts(buffer);
-				uart_puts_P("IV\r\n");
-				commandCode[0] = 0x0;
-			}
-		
-			serCmndReady = 0;
-			
-			
-		}/*if (serCmndReady)*/
-
-		if(externalPulseFlag == 1)
-		{
-			processPulse();
-		}
-		else
-		{
-			/*Only action serial command if we haven't just processed an external pulse event, so as to
-			reduce amount of processing we have to do in a given loop. Processing of serial commands
-			isn't time critical whereas processing of the external pulse event is.*/
-			switch ((uint8_t)commandCode[0])
-			{
-
-				/*Reset class of command*/
-				case 'R':
-					switch((uint8_t)commandCode[1])
-					{
-						/*Reset All*/
-						case 'A':
-							uart_puts_P("RA\r");
-							totalPulseCount = 0;
-							minTimerTicks = 65535;
-							localTimerTicksSum = 0;
-							minTickError = 0;
-							break;
-						/*Reset Minimum Interval measurement only*/
-						case 'M':
-							uart_puts_P("RM\r");
-							minTimerTicks = 65535;
-							break;
-						/*Reset Error counter that determines how many intervals with a 
-						duration less than minimum expected have been seen*/
-						case 'E':
-							uart_puts_P("RE\r");
-							minTickError = 0;
-							break;
-						
-						default:
-							break;
-					}
-
-					commandCode[0] = 0x0;
-
-					break;
-
-
-
-				/*Get class of command*/
-				case 'G':
-					switch((uint8_t)commandCode[1])
-					{
-						case 'A':
-							sendTotalCount();
-							break;
-						case 'M':
-							utoa( minTimerTicks, buffer, 10);
-							uart_puts(buffer);
-							uart_puts_P("\r\n");
-							break;
-
-						case 'E':
-							utoa( minTickError, buffer, 10);
-							uart_puts(buffer);
-							uart_puts_P("\n\r");
-							break;
-						
-						default:
-							break;
-					}
-
-					commandCode[0] = 0x0;
-
-					break;
-
-
-				default:	
-					break;
-			}/*end switch ((uint8_t)commandCode[0])*/
-
-		} /*if(externalPulseFlag == 1)*/
-		
-
-	
-	}/*end while(1)*/
-
-   
-}
-
-
-
-#if 1
-void sendTotalCount()
-{
-	
-	uart_puts_P("totalTicks,");
-	/*totalPulseCount can be directly converted to total kWh consumed, just divide by 1600*/
-	ultoa( totalPulseCount, buffer, 10);
-	uart_puts(buffer);
-	uart_puts_P(",");
-	/*localTimerTicksAvg is the number of timer ticks (each tick currently configured to happen every 1/3600 sec),
-	between rising edges of the power meter LED pulse input to the AVR, averaged over a set number of pulses, determined
-	by the constant UPDATE_RATE*/
-	utoa( localTimerTicksAvg, buffer, 10);
-	uart_puts(buffer);
-	uart_puts_P(",");
-	/*minTimerTicks keeps track of the minimum interval (in integer numbers of 1/3600 sec) measured between Power Meter
-	LED flashes. This would correspond to a time of maximum household power draw. Currently this value is an 'all time'
-	minimum value, i.e the minimum since the last AVR reset or counter reset. This may not be particularly useful as
-	the PC logging app could keep track of such things, particularly if we also output the current non averaged 
-	instantaneous pulse interval measurement too*/
-	utoa( minTimerTicks, buffer, 10);
-	uart_puts(buffer);
-	uart_puts_P("\r\n");
-
-
-}
-#endif
-
-
-void ports_init()
-{
-	// External Interrupt Control Register A,
-	//interrupt on INT0 pin rising edge (sensor triggered) 
-  	EICRA = (1<<ISC01) | (1<<ISC00);
-	//MCUCR = (1<<ISC01);
-
-  	// turn on external interrupt 0, PD2 on ATMega328P, Pin 4, (D0, Pin 15 on DT107a SIMMBUS connector)
-  	EIMSK  = _BV(INT0);
-
-
-	// set LED pin to output and switch on LED connected to PD3 on AVR, (D1, Pin 4 on DT107a SIMMBUS connector)
-    LED_DDR |= _BV(LED1);
-    LED_PORT &= ~_BV(LED1);
-
-	
-	/*Configure PD2 with weak pull up, helps prevent glitching from external EMI and glitches*/
-	PORTD = (1 << PD2);
-	DDRD = DDRD & ~_BV(PIND2);
-}		
-
-/*External pulse interrupt on PD2*/
-ISR(INT0_vect)
-{ 
-    
-	
-	/* Disable interrupts */
-
-	cli();
-	thisTimer1Count = TCNT1;
-	
-	TCNT1 = 0;
-	
-
-	
-
-	/*Toggles bit 0 in the MCU Control Register. This is responsible for determining whether INT0 is
-	rising edge or falling edge triggered. By flipping between them the interrupt will be triggered on
-	both rising and falling edge*/
-	//MCUCR = MCUCR ^ _BV(ISC00);
-
-	externalPulseFlag = 1;
-	
-	sei();
-
-	//LED_PORT = LED_PORT ^ _BV(LED1);	//toggle LED
-
-}
-
-
-/*service timer1 interrupts*/
-#if 0
-ISR(TIMER1_OVF_vect)     /* signal handler for Timer 1 over flow*/
-{
-/*The timer is in free run when it rolls over time has passed.
-Increment roll over counter, An interrupt comes every second.
-Maintain the times structure*/
-	LED_PORT = LED_PORT ^ _BV(LED);	//toggle LED
-
-	timerRollOverFlag = 1;
-}
-
-#if 0
-void myTimer1IntHandler(void)
-{
-/*The timer is in free run when it rolls over time has passed.
-Increment roll over counter.  This timer is incrementing at a rate of F_CPU/timer1GetPrescaler(),
-which makes it 3600Hz with F_CPU = 3686400Hz, and prescaler of 1024.*/
-	LED_PORT = LED_PORT ^ _BV(LED1);	//toggle LED
-	timerRollOverFlag = 1;
-
-	
-}
-#endif
-#endif
-
-//
-// end of file toggle.c
-////////////////////////////////////////////////////////////
+//
+// pwrmonNode_main.c
+//
+// The main file containing the kernel of the Smart Power Monitor 
+// Remote Node.
+//
+// Author: Richard C Clarke
+// Date: March 2009
+//
+
+
+// includes
+
+#include <stdlib.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <inttypes.h>
+
+#include "global.h"
+#include "timer.h"
+
+#include "uart.h"		// include uart function library
+#include "serialcommand_rcc.h"
+#include "pulseCapture.h"
+#include "processPulse.h"
+#include "reportFrame.h"
+#include "decFormat.h"
+#include "eepromStore.h"
+#include "taskSched.h"
+#include "profiler.h"
+#include "uartsw_tx.h"
+
+//u08 UART_NL[] = {0x0d,0x0a,0};
+
+#define SMALL_MEMORY 0
+#define DEBUG_SERIAL 1
+
+
+// defines
+#define LED_DDR  DDRD
+#define LED_PORT PORTD
+#define LED_PIN  PIND
+#define LED1     PIND3
+
+
+/*INT0 is on PORTD, PD2*/
+#define PULSE_INT DDRD
+
+#define UPDATE_RATE 10
+
+//#define F_CPU 8000000
+
+/*Serial rates that can be selected with the SB command, by index. BAUD_0 is used at power up
+until a rate saved in EEPROM is restored. 3.6864MHz divides exactly into every one of these*/
+#define BAUD_0		9600UL
+#define BAUD_1		19200UL
+#define BAUD_2		38400UL
+#define BAUD_3		57600UL
+#define BAUD_4		115200UL
+#define BAUD_5		230400UL
+#define BAUD_ENTRIES	6
+
+#if (UART_BAUD_ERROR(BAUD_0) > UART_BAUD_ERROR_MAX) || (UART_BAUD_ERROR(BAUD_1) > UART_BAUD_ERROR_MAX) ||\
+	(UART_BAUD_ERROR(BAUD_2) > UART_BAUD_ERROR_MAX) || (UART_BAUD_ERROR(BAUD_3) > UART_BAUD_ERROR_MAX) ||\
+	(UART_BAUD_ERROR(BAUD_4) > UART_BAUD_ERROR_MAX) || (UART_BAUD_ERROR(BAUD_5) > UART_BAUD_ERROR_MAX)
+#error A serial rate in the baud table cannot be generated accurately enough from F_CPU
+#endif
+
+#define UART_BAUD_RATE      BAUD_0
+
+/*After switching rate with SB the host has this long to send a valid command at the new rate,
+otherwise the node drops back to the old one*/
+#define BAUD_CONFIRM_SECS	10
+
+/*Put the CPU to sleep in idle mode whenever a pass of the main loop finds nothing to do. Every
+event the loop acts on comes with an interrupt, which wakes it again*/
+#ifndef IDLE_SLEEP
+#define IDLE_SLEEP	1
+#endif
+
+/*Send the power and energy of each completed averaging window out of the software UART on PD7
+as well, as a line of kW,kWh, for a local display or logger that doesn't take part in the host's
+polling. Lines are only queued whole, a line that doesn't fit waits for the next pass*/
+#ifndef UARTSW_TELEMETRY
+#define UARTSW_TELEMETRY	1
+#endif
+
+/*Longest telemetry line, 225.00 kW at the pulse floor and the energy register at its largest*/
+#define TELEMETRY_LINE_MAX	20
+
+
+
+
+
+/*Prototype*/
+void myTimer1IntHandler(void);
+void debugInfoOut(void);
+void debugCSVInfoOut(void);
+static void txWaitService(void);
+static void baudService(void);
+#if IDLE_SLEEP
+static void idleSleep(void);
+#endif
+void ports_init(void);
+
+
+
+
+
+/*Global volatile variables, modifiable by ISR's. Volatile variables larger than 1 byte must be
+read and written in one atomic operation. Interrupts must either be disabled or a local copy made
+of the volatile variable before using it in an operation*/
+volatile BOOL timerRollOverFlag;
+
+/*Set by each ISR with WAKE_MARK(), read and cleared by idleSleep() to find out what woke the CPU*/
+volatile u08 wakeFlags;
+//uint16_t localTimerTicks;
+
+/*For Debug, keep track of the minimum duration seen on PD2 between external interrupts.
+This number is in terms of number of ticks of a counter being incremented at the rate of 
+3600Hz*/
+uint32_t minTimerTicks;
+
+//uint16_t tickRate_Hz;
+uint16_t prescaleDiv;
+uint16_t timerVal;
+//uint32_t pulse_interval_sum;
+uint32_t localTimerTicksSum;
+
+/*The number of LED pulses between sending latest measurements out serial port, also the
+length of the boxcar interval average. Set with the SW command*/
+uint8_t averageWindow;
+/*Smoothing of the exponential interval average, alpha = 1/2^emaShift. Set with the SK command*/
+uint8_t emaShift;
+uint16_t pulse_ticker;
+
+
+/*Keeps track of the total number of pulses counted since last reset or variable clear command*/
+uint32_t totalPulseCount;
+
+/*Serial rate, index into baudTable. baudIndex is the last rate confirmed by the host, the one
+saved in EEPROM. baudActiveIndex is the rate in use, which differs while a switch made with SB
+waits to be confirmed. baudState tracks the switch*/
+uint8_t baudIndex;
+static uint8_t baudActiveIndex;
+static uint8_t baudState;
+static uint32_t baudSwitchTime;
+
+#if IDLE_SLEEP
+/*Sleep accounting, cleared by RS. Times are in Timer1 ticks. Wakeups are counted once for each
+cause flagged while asleep, so a wakeup with two interrupts pending counts against both.
+
+The Timer0 overflow wakes the CPU every 4.4ms, far shorter than a Timer1 tick, so each sleep is
+timed on Timer0 and the Timer0 ticks left over from whole Timer1 ticks are carried in
+sleepTicksFrac*/
+static uint32_t sleepCount;
+static uint32_t wakeCount[WAKE_NUM_CAUSES];
+static uint32_t sleepTicks;
+static uint8_t sleepTicksFrac;
+static uint32_t sleepStatsStart;
+
+/*Timer0 ticks of F_CPU/64 in one Timer1 tick of F_CPU/1024*/
+#define SLEEP_T0_PER_T1		16
+#endif
+
+enum baudState_t
+{
+	BAUD_STEADY,
+	BAUD_SWITCH,		/*waiting for the SB reply to finish going out at the old rate*/
+	BAUD_CONFIRM		/*running at the new rate, waiting for the host to prove it can talk*/
+};
+
+static const uint32_t baudTable[BAUD_ENTRIES] PROGMEM =
+{
+	BAUD_0, BAUD_1, BAUD_2, BAUD_3, BAUD_4, BAUD_5
+};
+
+/*Set when an averaging window completes, cleared once the new measurements have been pushed
+to any subscribed host*/
+static uint8_t measureDataChange;
+
+#if !RS485_MULTIDROP
+/*Power in the last ON_CHANGE report, MAX_U32 if there hasn't been one*/
+static uint32_t reportedKWX100;
+#endif
+
+#if UARTSW_TELEMETRY
+/*Set with measureDataChange, cleared once the telemetry line has been queued*/
+static uint8_t telemetryDue;
+
+static void telemetrySend(void);
+#endif
+
+/*Reporting mode, ON_CHANGE, ON_QUERY and SEND_TOTAL_COUNT bits. Set with the SM command*/
+uint8_t commandFlags;
+/*Power change that triggers an ON_CHANGE report, kW x 100. Set with the ST command*/
+uint16_t reportThreshold;
+
+/*Address on a multidrop bus, set with the SI command. Kept in EEPROM whatever the build, so it
+survives a change to a build without RS485_MULTIDROP and back*/
+uint8_t nodeAddress;
+
+static uint8_t cmdResetAll(uint16_t value);
+static uint8_t cmdResetMin(uint16_t value);
+static uint8_t cmdResetRejects(uint16_t value);
+static uint8_t cmdResetHist(uint16_t value);
+static uint8_t cmdResetQueue(uint16_t value);
+static uint8_t cmdResetTx(uint16_t value);
+#if IDLE_SLEEP
+static uint8_t cmdResetSleep(uint16_t value);
+static uint8_t cmdGetSleep(uint16_t value);
+#endif
+static uint8_t cmdGetAll(uint16_t value);
+static uint8_t cmdGetMin(uint16_t value);
+static uint8_t cmdGetRejects(uint16_t value);
+static uint8_t cmdGetWindow(uint16_t value);
+static uint8_t cmdGetHist(uint16_t value);
+static uint8_t cmdGetLog(uint16_t value);
+static uint8_t cmdGetQueue(uint16_t value);
+static uint8_t cmdGetTx(uint16_t value);
+static uint8_t cmdGetBaud(uint16_t value);
+static uint8_t cmdGetTasks(uint16_t value);
+static uint8_t cmdResetTasks(uint16_t value);
+#if PROFILE_ENABLE
+static uint8_t cmdGetProfile(uint16_t value);
+static uint8_t cmdResetProfile(uint16_t value);
+#endif
+static uint8_t cmdSetBaud(uint16_t value);
+static uint8_t cmdSetWindow(uint16_t value);
+static uint8_t cmdSetEmaShift(uint16_t value);
+static uint8_t cmdSetFormat(uint16_t value);
+static uint8_t cmdSetMode(uint16_t value);
+static uint8_t cmdSetThreshold(uint16_t value);
+#if RS485_MULTIDROP
+static uint8_t cmdSetAddress(uint16_t value);
+#endif
+#if PULSE_WIDTH_QUALIFY
+static uint8_t cmdResetWidth(uint16_t value);
+static uint8_t cmdGetWidth(uint16_t value);
+static uint8_t cmdSetWidthMin(uint16_t value);
+static uint8_t cmdSetWidthMax(uint16_t value);
+#endif
+
+/*Serial commands, looked up by sc_dispatch(). The value field of each command is checked against
+min and max before the handler is called. Commands flagged CMD_ACK echo their code once the handler
+has succeeded, the Get commands reply with their data instead*/
+static const struct cmdEntry_t cmdTable[] PROGMEM =
+{
+	/*Reset class of command*/
+	{ {'R','A'}, CMD_ACK, 0, MAX_U16, cmdResetAll },
+	{ {'R','M'}, CMD_ACK, 0, MAX_U16, cmdResetMin },
+	{ {'R','E'}, CMD_ACK, 0, MAX_U16, cmdResetRejects },
+	{ {'R','H'}, CMD_ACK, 0, MAX_U16, cmdResetHist },
+	{ {'R','Q'}, CMD_ACK, 0, MAX_U16, cmdResetQueue },
+	{ {'R','T'}, CMD_ACK, 0, MAX_U16, cmdResetTx },
+	{ {'R','O'}, CMD_ACK, 0, MAX_U16, cmdResetTasks },
+#if PROFILE_ENABLE
+	{ {'R','P'}, CMD_ACK, 0, MAX_U16, cmdResetProfile },
+#endif
+#if IDLE_SLEEP
+	{ {'R','S'}, CMD_ACK, 0, MAX_U16, cmdResetSleep },
+#endif
+#if PULSE_WIDTH_QUALIFY
+	{ {'R','D'}, CMD_ACK, 0, MAX_U16, cmdResetWidth },
+#endif
+
+	/*Get class of command*/
+	{ {'G','A'}, 0, 0, MAX_U16, cmdGetAll },
+	{ {'G','M'}, 0, 0, MAX_U16, cmdGetMin },
+	{ {'G','E'}, 0, 0, MAX_U16, cmdGetRejects },
+	{ {'G','W'}, 0, 0, MAX_U16, cmdGetWindow },
+	{ {'G','H'}, 0, 0, MAX_U16, cmdGetHist },
+	{ {'G','L'}, 0, 0, MAX_U16, cmdGetLog },
+#if PULSE_WIDTH_QUALIFY
+	{ {'G','D'}, 0, 0, MAX_U16, cmdGetWidth },
+#endif
+	{ {'G','Q'}, 0, 0, MAX_U16, cmdGetQueue },
+	{ {'G','T'}, 0, 0, MAX_U16, cmdGetTx },
+	{ {'G','B'}, 0, 0, MAX_U16, cmdGetBaud },
+	{ {'G','O'}, 0, 0, MAX_U16, cmdGetTasks },
+#if PROFILE_ENABLE
+	{ {'G','P'}, 0, 0, MAX_U16, cmdGetProfile },
+#endif
+#if IDLE_SLEEP
+	{ {'G','S'}, 0, 0, MAX_U16, cmdGetSleep },
+#endif
+
+	/*Set class of command*/
+	{ {'S','W'}, CMD_ACK, 1, AVG_WINDOW_MAX, cmdSetWindow },
+	{ {'S','K'}, CMD_ACK, EMA_SHIFT_MIN, EMA_SHIFT_MAX, cmdSetEmaShift },
+	{ {'S','F'}, CMD_ACK, REPORT_FORMAT_CSV, REPORT_FORMAT_BINARY, cmdSetFormat },
+	{ {'S','M'}, CMD_ACK, 0, REPORT_MODE_MASK, cmdSetMode },
+	{ {'S','T'}, CMD_ACK, 0, MAX_U16, cmdSetThreshold },
+	{ {'S','B'}, CMD_ACK, 0, BAUD_ENTRIES - 1, cmdSetBaud },
+#if RS485_MULTIDROP
+	{ {'S','I'}, CMD_ACK, 0, CMD_ADDR_BROADCAST - 1, cmdSetAddress },
+#endif
+#if PULSE_WIDTH_QUALIFY
+	{ {'S','N'}, CMD_ACK, 0, MAX_U16, cmdSetWidthMin },
+	{ {'S','X'}, CMD_ACK, 0, MAX_U16, cmdSetWidthMax },
+#endif
+};
+
+#define CMD_TABLE_ENTRIES	(sizeof(cmdTable)/sizeof(cmdTable[0]))
+
+static uint8_t taskPulse(void);
+static uint8_t taskCommand(void);
+static uint8_t taskReport(void);
+static uint8_t taskStore(void);
+
+/*Main loop tasks, highest priority first, with the longest each should take over one run. A
+pulse is never kept waiting by more than one run of a lower task. The budgets are allowances to
+catch anything unexpectedly slow with the GO command. A command that has to wait for room in the
+transmit buffer will overrun, a full GH reply at 9600 baud takes around 90ms to go out*/
+static const struct taskEntry_t taskTable[] PROGMEM =
+{
+	{ taskPulse, SCHED_US(2000) },
+	{ taskCommand, SCHED_US(20000) },
+	{ taskReport, SCHED_US(10000) },
+	{ taskStore, SCHED_US(1000) },
+};
+
+#define TASK_TABLE_ENTRIES	(sizeof(taskTable)/sizeof(taskTable[0]))
+
+
+//
+// main function
+//
+int main(void) 
+{
+
+
+	
+	uint16_t tickRate_Hz;
+
+		
+
+	ports_init();
+
+	// initialize our libraries
+	/*
+     *  Initialize UART library, pass baudrate and AVR cpu clock
+     *  with the macro 
+     *  UART_BAUD_SELECT() (normal speed mode )
+     *  or 
+     *  UART_BAUD_SELECT_DOUBLE_SPEED() ( double speed mode)
+     */
+    //uart_init( UART_BAUD_SELECT(UART_BAUD_RATE,F_CPU) ); 
+	uart_init(UART_BAUD_RATE);
+	/*Keep the pulses processed while waiting on a full transmit buffer*/
+	uart_setTxWaitHook(txWaitService);
+
+	// initialize the timer system, enables global interrupts.
+	
+	//timer1Init();
+	/*Timer clocked at F_CPU/1024*/
+
+	timer1SetPrescaler(TIMER_CLK_DIV1024);
+	/*Count TCNT1 overflows to extend Timer1 to 32 bits, so pulse intervals longer than
+	65535/3600 = 18.2 sec don't wrap*/
+	timer1ClearOverflowCount();
+	sbi(TIMSK1, TOIE1);						// enable TCNT1 overflow
+	//timerAttach(1, myTimer1IntHandler );
+
+	/*Timer0 at F_CPU/64 is the fine timebase for the task budgets, profiling and sleep timing*/
+	timer0Init();
+
+#if UARTSW_TELEMETRY
+	/*Timer2 and PD7 for the telemetry line*/
+	uartswInit_Tx();
+#endif
+
+	/*Start timestamping the LED pulses against the free running Timer1*/
+	pulseCaptureInit();
+	processPulseInit();
+
+	timerRollOverFlag = 0;
+	/*Counts the pulses from the LED pulse detector, after every 160 increment the 
+	0.1 decimal KWh counter*/
+	pulse_ticker = 0;
+
+	averageWindow = UPDATE_RATE;
+	emaShift = EMA_SHIFT_DEFAULT;
+	reportFormat = REPORT_FORMAT_CSV;
+	measureDataChange = 0;
+	commandFlags = _BV(ON_QUERY);
+	reportThreshold = REPORT_THRESHOLD_DEFAULT;
+	nodeAddress = CMD_ADDR_DEFAULT;
+#if !RS485_MULTIDROP
+	reportedKWX100 = MAX_U32;
+#endif
+	totalPulseCount = 0;
+	minTimerTicks = MAX_U32;
+	intervalAvgReset();
+	energyReset();
+#if PROFILE_ENABLE
+	profileClear();
+#endif
+	pulseFilterReset();
+	pulseRejectClear();
+	intervalHistClear();
+
+	/*Pick up the pulse count and settings from the last EEPROM checkpoint, if there is one*/
+	baudIndex = 0;
+	baudState = BAUD_STEADY;
+	eepromStoreInit();
+	if(baudIndex >= BAUD_ENTRIES)
+	{
+		baudIndex = 0;
+	}
+	baudActiveIndex = baudIndex;
+	uart_setBaud(pgm_read_dword(&baudTable[baudActiveIndex]));
+#if RS485_MULTIDROP
+	if(nodeAddress == CMD_ADDR_BROADCAST)
+	{
+		nodeAddress = CMD_ADDR_DEFAULT;
+	}
+	sc_setAddress(nodeAddress);
+#endif
+
+
+	/*********************************************
+	* Test Timer Ticks to Millisecond Calculation
+	**********************************************/
+	/*Result here is time in milliseconds x 10, to give 0.1ms resolution
+	in the calculation, otherwise can only represent times to integer numbers
+	of 1ms increments*/
+	tickRate_Hz = (F_CPU/timer1GetPrescaler());
+
+	
+	// enable global interrupts
+	sei();
+
+	/*
+     *  Transmit string to UART
+     *  The string is buffered by the uart library in a circular buffer
+     *  and one character at a time is transmitted to the UART using interrupts.
+     *  uart_puts() blocks if it can not write the whole string to the circular 
+     *  buffer
+     */
+    
+#if !RS485_MULTIDROP
+    /*
+     * Transmit string from program memory to UART
+     */
+    uart_puts_P("PowerMeterMonitor\r\n");
+	
+
+	/*CSV Column headings*/
+	uart_puts_P("(totalCount,Avged Interval, Min Interval, Exp Avged Interval, kW, kWh)\r\n");
+#endif
+    
+  
+
+#if IDLE_SLEEP
+	sleepStatsStart = timer1GetTimestamp();
+#endif
+
+	/*Main kernel loop, everything the node does outside its interrupts is one of the tasks in
+	taskTable*/
+	while(1) 	    /* Forever */
+	{
+#if IDLE_SLEEP
+		if(!schedRun(taskTable, TASK_TABLE_ENTRIES))
+		{
+			idleSleep();
+		}
+#else
+		schedRun(taskTable, TASK_TABLE_ENTRIES);
+#endif
+	}/*end while(1)*/
+
+   
+}
+
+
+
+/*Main loop tasks, one per entry in taskTable. Each returns TRUE if it did something*/
+
+/*Measure the pulses waiting in the queue*/
+static uint8_t taskPulse(void)
+{
+	if(!pulseQueueAvailable())
+	{
+		return FALSE;
+	}
+
+	if(processPulse())
+	{
+		measureDataChange = 1;
+#if UARTSW_TELEMETRY
+		telemetryDue = 1;
+#endif
+		reportInvalidate();
+	}
+	return TRUE;
+}
+
+/*Carry out the next received command. Serial commands aren't time critical, so they wait for the
+pulse queue to be drained*/
+static uint8_t taskCommand(void)
+{
+	static struct serialCmd_t serialCmd;
+
+	baudService();
+
+	if(!sc_getCmd(&serialCmd))
+	{
+		return FALSE;
+	}
+
+#if RS485_MULTIDROP
+	/*Every node acts on a broadcast, none of them answer it*/
+	uart_setTxMute(serialCmd.broadcast);
+#endif
+	/*A good command at the new rate confirms a switch with SB*/
+	if( (serialCmd.result == CMD_VALID) && (baudState == BAUD_CONFIRM) )
+	{
+		baudIndex = baudActiveIndex;
+		baudState = BAUD_STEADY;
+		eepromStoreRequest();
+	}
+
+	sc_execute(cmdTable, CMD_TABLE_ENTRIES, &serialCmd);
+#if RS485_MULTIDROP
+	uart_setTxMute(FALSE);
+#endif
+	return TRUE;
+}
+
+/*Render the report for the window just completed while there is time to spare, so it is ready
+to go when it is asked for, and push it to subscribed hosts*/
+static uint8_t taskReport(void)
+{
+	uint8_t worked;
+#if !RS485_MULTIDROP
+	uint32_t kWX100;
+#endif
+
+	worked = reportUpdate();
+
+#if !RS485_MULTIDROP	/*nothing is pushed on a multidrop bus, nodes only speak when spoken to*/
+	/*Push the new measurements once the pulse queue is drained, so a burst of pulses produces
+	one report rather than several. If there isn't room for the whole report in the transmit
+	buffer it is held over to a later pass rather than waiting, by when it may have been
+	overtaken by newer measurements. reportPush() never waits either, and queues all of the report
+	or none of it*/
+	if( measureDataChange && (uart_txFree() >= reportLength()) )
+	{
+		measureDataChange = 0;
+		worked = TRUE;
+
+		if(commandFlags & _BV(SEND_TOTAL_COUNT))
+		{
+			reportPush();
+		}
+		else if(commandFlags & _BV(ON_CHANGE))
+		{
+			kWX100 = powerKWX100();
+			if( (reportedKWX100 == MAX_U32) ||
+				((kWX100 > reportedKWX100) && ((kWX100 - reportedKWX100) > reportThreshold)) ||
+				((kWX100 < reportedKWX100) && ((reportedKWX100 - kWX100) > reportThreshold)) )
+			{
+				if(reportPush())
+				{
+					reportedKWX100 = kWX100;
+				}
+			}
+		}
+	}
+#endif
+
+#if UARTSW_TELEMETRY
+	if( telemetryDue && (uartswTxFree() >= TELEMETRY_LINE_MAX) )
+	{
+		telemetryDue = 0;
+		worked = TRUE;
+		telemetrySend();
+	}
+#endif
+
+	return worked;
+}
+
+#if UARTSW_TELEMETRY
+/*Queue the kW,kWh line on the software UART. The caller has made sure there is room for it*/
+static void telemetrySend(void)
+{
+	char line[(2 * DEC_FORMAT_MAX) + 2];
+	char *p;
+	char *c;
+
+	p = decFormat(line, powerKWX100(), 0, 2);
+	*p++ = ',';
+	p = decFormat(p, energyKWhX100(), 0, 2);
+	*p++ = '\r';
+	*p++ = '\n';
+
+	for(c=line;c<p;c++)
+	{
+		uartswSendByte(*c);
+	}
+}
+#endif
+
+/*Carry on with, or start, an EEPROM checkpoint. Nothing interrupts when the EEPROM is ready, so
+it counts as work for as long as a checkpoint is being written, to keep it polled*/
+static uint8_t taskStore(void)
+{
+	eepromStoreService();
+	return eepromStoreBusy();
+}
+
+
+
+/*Command handlers, one per entry in cmdTable. value is the command's 16 bit value field, already
+range checked against the table. Returning FALSE makes sc_dispatch() reply IV instead of the
+acknowledgement*/
+
+/*Reset All*/
+static uint8_t cmdResetAll(uint16_t value)
+{
+	totalPulseCount = 0;
+	energyReset();
+	minTimerTicks = MAX_U32;
+	intervalAvgReset();
+	pulseFilterReset();
+	pulseRejectClear();
+	intervalHistClear();
+	reportInvalidate();
+	eepromStoreRequest();
+	return TRUE;
+}
+
+/*Reset Minimum Interval measurement only*/
+static uint8_t cmdResetMin(uint16_t value)
+{
+	minTimerTicks = MAX_U32;
+	reportInvalidate();
+	return TRUE;
+}
+
+/*Reset the counters of intervals rejected by the glitch filter*/
+static uint8_t cmdResetRejects(uint16_t value)
+{
+	pulseRejectClear();
+	return TRUE;
+}
+
+/*Reset the interval histogram*/
+static uint8_t cmdResetHist(uint16_t value)
+{
+	intervalHistClear();
+	return TRUE;
+}
+
+/*Reset the pulse queue overflow and high watermark counters*/
+static uint8_t cmdResetQueue(uint16_t value)
+{
+	pulseQueueClearStats();
+	return TRUE;
+}
+
+/*Reset the serial transmit stall and drop counters*/
+static uint8_t cmdResetTx(uint16_t value)
+{
+	uart_clearTxStats();
+	return TRUE;
+}
+
+/*Reset the main loop task statistics*/
+static uint8_t cmdResetTasks(uint16_t value)
+{
+	schedClearStats();
+	return TRUE;
+}
+
+#if PROFILE_ENABLE
+/*Reset the profile counters*/
+static uint8_t cmdResetProfile(uint16_t value)
+{
+	profileClear();
+	return TRUE;
+}
+#endif
+
+#if IDLE_SLEEP
+/*Reset the sleep accounting*/
+static uint8_t cmdResetSleep(uint16_t value)
+{
+	uint8_t i;
+
+	sleepCount = 0;
+	for(i=0;i<WAKE_NUM_CAUSES;i++)
+	{
+		wakeCount[i] = 0;
+	}
+	sleepTicks = 0;
+	sleepTicksFrac = 0;
+	sleepStatsStart = timer1GetTimestamp();
+	return TRUE;
+}
+#endif
+
+#if PULSE_WIDTH_QUALIFY
+/*Reset the pulse width histogram and width reject counter*/
+static uint8_t cmdResetWidth(uint16_t value)
+{
+	pulseWidthHistClear();
+	return TRUE;
+}
+#endif
+
+
+
+/*Latest measurements*/
+static uint8_t cmdGetAll(uint16_t value)
+{
+	reportSend();
+	return TRUE;
+}
+
+static uint8_t cmdGetMin(uint16_t value)
+{
+	decPut(minTimerTicks, 0, 0);
+	uart_puts_P("\r\n");
+	return TRUE;
+}
+
+/*Glitch filter rejections, one count per reason, (below floor, deviation from recent intervals)*/
+static uint8_t cmdGetRejects(uint16_t value)
+{
+	uint8_t i;
+
+	for(i=0;i<REJECT_NUM_REASONS;i++)
+	{
+		if(i)
+		{
+			uart_puts_P(",");
+		}
+		decPut(pulseRejectCount[i], 0, 0);
+	}
+	uart_puts_P("\r\n");
+	return TRUE;
+}
+
+/*Averaging settings, (window length in pulses, exponential average shift)*/
+static uint8_t cmdGetWindow(uint16_t value)
+{
+	decPut(averageWindow, 0, 0);
+	uart_puts_P(",");
+	decPut(emaShift, 0, 0);
+	uart_puts_P("\r\n");
+	return TRUE;
+}
+
+/*Interval histogram, INTERVAL_HIST_BINS counts from the shortest intervals (highest load) to
+the longest*/
+static uint8_t cmdGetHist(uint16_t value)
+{
+	uint8_t i;
+
+	for(i=0;i<INTERVAL_HIST_BINS;i++)
+	{
+		if(i)
+		{
+			uart_puts_P(",");
+		}
+		decPut(intervalHistGet(i), 0, 0);
+	}
+	uart_puts_P("\r\n");
+	return TRUE;
+}
+
+/*Interval log download, one line per log slot from sequence number value on, (seq, pulses,
+ticks). Slots already overwritten are skipped. The last line is GL and the sequence
+number to ask for next time*/
+static uint8_t cmdGetLog(uint16_t value)
+{
+	uint16_t logSeq;
+	uint16_t logPulses;
+	uint32_t logTicks;
+
+	for(logSeq = intervalLogOldestSeq(value); logSeq != intervalLogNextSeq(); logSeq++)
+	{
+		/*Pulses keep being processed while this waits on the serial line, so slots can
+		complete and push the oldest ones out from under it*/
+		logSeq = intervalLogOldestSeq(logSeq);
+		intervalLogGet(logSeq, &logPulses, &logTicks);
+		decPut(logSeq, 0, 0);
+		uart_puts_P(",");
+		decPut(logPulses, 0, 0);
+		uart_puts_P(",");
+		decPut(logTicks, 0, 0);
+		uart_puts_P("\r\n");
+	}
+	uart_puts_P("GL,");
+	decPut(logSeq, 0, 0);
+	uart_puts_P("\r\n");
+	return TRUE;
+}
+
+#if PULSE_WIDTH_QUALIFY
+/*Pulse width diagnostics, (pulses rejected for their width, then the width histogram,
+PULSE_WIDTH_HIST_BINS bins of 2^PULSE_WIDTH_HIST_SHIFT ticks)*/
+static uint8_t cmdGetWidth(uint16_t value)
+{
+	uint8_t i;
+
+	decPut(pulseWidthHistGet(PULSE_WIDTH_HIST_BINS), 0, 0);
+	for(i=0;i<PULSE_WIDTH_HIST_BINS;i++)
+	{
+		uart_puts_P(",");
+		decPut(pulseWidthHistGet(i), 0, 0);
+	}
+	uart_puts_P("\r\n");
+	return TRUE;
+}
+#endif
+
+/*Pulse queue health, (pulses lost to a full queue, most pulses ever waiting)*/
+static uint8_t cmdGetQueue(uint16_t value)
+{
+	uint16_t queueOverflows;
+	uint8_t queueHighWater;
+
+	pulseQueueGetStats(&queueOverflows, &queueHighWater);
+	decPut(queueOverflows, 0, 0);
+	uart_puts_P(",");
+	decPut(queueHighWater, 0, 0);
+	uart_puts_P("\r\n");
+	return TRUE;
+}
+
+
+
+/*Serial rate in use, bps*/
+static uint8_t cmdGetBaud(uint16_t value)
+{
+	decPut(pgm_read_dword(&baudTable[baudActiveIndex]), 0, 0);
+	uart_puts_P("\r\n");
+	return TRUE;
+}
+
+#if IDLE_SLEEP
+/*Sleep accounting, (times slept, wakeups by pulse, serial receive, serial transmit and timer,
+Timer1 ticks spent awake and ticks since the counters were cleared)*/
+static uint8_t cmdGetSleep(uint16_t value)
+{
+	uint32_t elapsed;
+	uint8_t i;
+
+	elapsed = timer1GetTimestamp() - sleepStatsStart;
+
+	decPut(sleepCount, 0, 0);
+	for(i=0;i<WAKE_NUM_CAUSES;i++)
+	{
+		uart_puts_P(",");
+		decPut(wakeCount[i], 0, 0);
+	}
+	uart_puts_P(",");
+	decPut(elapsed - sleepTicks, 0, 0);
+	uart_puts_P(",");
+	decPut(elapsed, 0, 0);
+	uart_puts_P("\r\n");
+	return TRUE;
+}
+#endif
+
+/*Main loop task statistics, one line per task in priority order, (runs, overruns, longest run
+and budget in Timer0 ticks of 64 clocks)*/
+static uint8_t cmdGetTasks(uint16_t value)
+{
+	struct taskStats_t stats;
+	uint8_t i;
+
+	for(i=0;i<TASK_TABLE_ENTRIES;i++)
+	{
+		schedGetStats(i, &stats);
+		decPut(stats.runs, 0, 0);
+		uart_puts_P(",");
+		decPut(stats.overruns, 0, 0);
+		uart_puts_P(",");
+		decPut(stats.worst, 0, 0);
+		uart_puts_P(",");
+		decPut(pgm_read_word(&taskTable[i].budget), 0, 0);
+		uart_puts_P("\r\n");
+	}
+	return TRUE;
+}
+
+#if PROFILE_ENABLE
+/*Profile counters, one line per region in profileRegion_t order, (count, total, min and max in
+Timer0 ticks of 64 clocks). min reads 65535 for a region not yet timed*/
+static uint8_t cmdGetProfile(uint16_t value)
+{
+	struct profileStats_t stats;
+	uint8_t i;
+
+	for(i=0;i<PROF_NUM_REGIONS;i++)
+	{
+		profileGet(i, &stats);
+		decPut(stats.count, 0, 0);
+		uart_puts_P(",");
+		decPut(stats.total, 0, 0);
+		uart_puts_P(",");
+		decPut(stats.min, 0, 0);
+		uart_puts_P(",");
+		decPut(stats.max, 0, 0);
+		uart_puts_P("\r\n");
+	}
+	return TRUE;
+}
+#endif
+
+/*Serial link health, (times a write had to wait for room, bytes dropped, received commands
+lost to a full command queue)*/
+static uint8_t cmdGetTx(uint16_t value)
+{
+	unsigned int stalls;
+	unsigned int drops;
+
+	uart_getTxStats(&stalls, &drops);
+	decPut(stalls, 0, 0);
+	uart_puts_P(",");
+	decPut(drops, 0, 0);
+	uart_puts_P(",");
+	decPut(sc_getOverflows(), 0, 0);
+	uart_puts_P("\r\n");
+	return TRUE;
+}
+
+
+
+/*Length of the boxcar averaging window, in pulses*/
+static uint8_t cmdSetWindow(uint16_t value)
+{
+	averageWindow = (uint8_t)value;
+	intervalAvgReset();
+	reportInvalidate();
+	eepromStoreRequest();
+	return TRUE;
+}
+
+/*Exponential average smoothing, alpha = 1/2^value*/
+static uint8_t cmdSetEmaShift(uint16_t value)
+{
+	emaShift = (uint8_t)value;
+	eepromStoreRequest();
+	return TRUE;
+}
+
+/*Serial rate, index into baudTable. The reply goes out at the old rate, the host then has
+BAUD_CONFIRM_SECS to send any valid command at the new one. Commands sent after SB that are
+still waiting when the rate switches are thrown away unanswered*/
+static uint8_t cmdSetBaud(uint16_t value)
+{
+	if(baudState != BAUD_STEADY)
+	{
+		return FALSE;
+	}
+
+	baudActiveIndex = (uint8_t)value;
+	baudState = BAUD_SWITCH;
+	return TRUE;
+}
+
+/*Reporting mode, any combination of the ON_CHANGE, ON_QUERY and SEND_TOTAL_COUNT bits*/
+static uint8_t cmdSetMode(uint16_t value)
+{
+	commandFlags = (uint8_t)value;
+	eepromStoreRequest();
+	return TRUE;
+}
+
+/*Power change that triggers an ON_CHANGE report, kW x 100*/
+static uint8_t cmdSetThreshold(uint16_t value)
+{
+	reportThreshold = value;
+	eepromStoreRequest();
+	return TRUE;
+}
+
+/*Report format, 0 for the CSV line, 1 for binary frames*/
+static uint8_t cmdSetFormat(uint16_t value)
+{
+	reportFormat = (uint8_t)value;
+	reportInvalidate();
+	eepromStoreRequest();
+	return TRUE;
+}
+
+#if RS485_MULTIDROP
+/*Address on the multidrop bus. The acknowledgement still goes out, the next command has to
+use the new address*/
+static uint8_t cmdSetAddress(uint16_t value)
+{
+	nodeAddress = (uint8_t)value;
+	sc_setAddress(nodeAddress);
+	eepromStoreRequest();
+	return TRUE;
+}
+#endif
+
+#if PULSE_WIDTH_QUALIFY
+/*Narrowest pulse accepted from the meter, in Timer1 ticks*/
+static uint8_t cmdSetWidthMin(uint16_t value)
+{
+	if( !pulseWidthSetMin(value) )
+	{
+		return FALSE;
+	}
+	eepromStoreRequest();
+	return TRUE;
+}
+
+/*Widest pulse accepted from the meter, in Timer1 ticks*/
+static uint8_t cmdSetWidthMax(uint16_t value)
+{
+	if( !pulseWidthSetMax(value) )
+	{
+		return FALSE;
+	}
+	eepromStoreRequest();
+	return TRUE;
+}
+#endif
+
+
+
+/*Run by uart_putc() while it waits for room in the transmit buffer, so the pulse timestamps
+never sit in the queue for the length of a long reply*/
+static void txWaitService(void)
+{
+	if(pulseQueueAvailable() && processPulse())
+	{
+		measureDataChange = 1;
+#if UARTSW_TELEMETRY
+		telemetryDue = 1;
+#endif
+		reportInvalidate();
+	}
+}
+
+
+
+/*Switch the serial rate over once the SB reply has completely gone, and fall back to the old
+rate if the host doesn't confirm the new one in time. A rate is only saved to EEPROM once it has
+been confirmed, so the node can't be left at a rate nothing can talk to it at. Whatever was
+received before a change of rate is thrown away with it, so only a command received in full at
+the new rate can confirm it, not one the host pipelined after SB at the old rate*/
+static void baudService(void)
+{
+	switch(baudState)
+	{
+		case BAUD_SWITCH:
+			if(uart_txIdle())
+			{
+				uart_setBaud(pgm_read_dword(&baudTable[baudActiveIndex]));
+				sc_flush();
+				baudSwitchTime = timer1GetTimestamp();
+				baudState = BAUD_CONFIRM;
+			}
+			break;
+
+		case BAUD_CONFIRM:
+			if( (timer1GetTimestamp() - baudSwitchTime) >= ((uint32_t)BAUD_CONFIRM_SECS * TIMER_TICK_RATE) )
+			{
+				baudActiveIndex = baudIndex;
+				uart_setBaud(pgm_read_dword(&baudTable[baudActiveIndex]));
+				sc_flush();
+				baudState = BAUD_STEADY;
+			}
+			break;
+
+		default:
+			break;
+	}
+}
+
+
+
+#if IDLE_SLEEP
+/*Sleep until the next interrupt, unless there is still something to do. Interrupts are held off
+from the last check until the sleep instruction, the one after sei() always runs first, so an
+interrupt arriving in between can't leave the loop asleep with work waiting.
+
+Not while an EEPROM checkpoint is being written, the EEPROM ready interrupt isn't used, or while a
+rate switch is in progress, neither the end of transmission nor the confirm timeout wakes the CPU*/
+static void idleSleep(void)
+{
+	uint16_t sleepStart;
+	uint16_t slept;
+	u08 flags;
+	uint8_t i;
+
+	cli();
+	if( pulseQueueAvailable() || sc_cmdAvailable() || eepromStoreBusy() || (baudState != BAUD_STEADY) )
+	{
+		sei();
+		return;
+	}
+
+	sleepStart = timer0GetTimestamp();
+	wakeFlags = 0;
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	sleep_enable();
+	sei();
+	sleep_cpu();
+	sleep_disable();
+
+	slept = timer0GetTimestamp() - sleepStart;
+	sleepTicks += slept / SLEEP_T0_PER_T1;
+	sleepTicksFrac += slept % SLEEP_T0_PER_T1;
+	if(sleepTicksFrac >= SLEEP_T0_PER_T1)
+	{
+		sleepTicksFrac -= SLEEP_T0_PER_T1;
+		sleepTicks++;
+	}
+
+	cli();
+	flags = wakeFlags;
+	wakeFlags = 0;
+	sei();
+
+	sleepCount++;
+	for(i=0;i<WAKE_NUM_CAUSES;i++)
+	{
+		if(flags & BV(i))
+		{
+			wakeCount[i]++;
+		}
+	}
+}
+#endif
+
+
+
+void ports_init()
+{
+	// set LED pin to output and switch on LED connected to PD3 on AVR, (D1, Pin 4 on DT107a SIMMBUS connector)
+    LED_DDR |= _BV(LED1);
+    LED_PORT &= ~_BV(LED1);
+
+	
+	/*Configure PD2 with weak pull up, helps prevent glitching from external EMI and glitches*/
+	PORTD = (1 << PD2);
+	DDRD = DDRD & ~_BV(PIND2);
+}		
+
+/*service timer1 interrupts*/
+#if 0
+ISR(TIMER1_OVF_vect)     /* signal handler for Timer 1 over flow*/
+{
+/*The timer is in free run when it rolls over time has passed.
+Increment roll over counter, An interrupt comes every second.
+Maintain the times structure*/
+	LED_PORT = LED_PORT ^ _BV(LED);	//toggle LED
+
+	timerRollOverFlag = 1;
+}
+
+#if 0
+void myTimer1IntHandler(void)
+{
+/*The timer is in free run when it rolls over time has passed.
+Increment roll over counter.  This timer is incrementing at a rate of F_CPU/timer1GetPrescaler(),
+which makes it 3600Hz with F_CPU = 3686400Hz, and prescaler of 1024.*/
+	LED_PORT = LED_PORT ^ _BV(LED1);	//toggle LED
+	timerRollOverFlag = 1;
+
+	
+}
+#endif
+#endif
+
+//
+// end of file toggle.c
+////////////////////////////////////////////////////////////
@@ -0,0 +1,246 @@
+//
+// reportFrame.c
+//
+// Renders the measurement report, either as the CSV line or as a
+// binary frame of little endian counters with a CRC16, COBS encoded.
+// The report is rendered once per snapshot into a cache and queries
+// are answered straight out of the cache.
+//
+// Author: Richard C Clarke
+// Date: March 2009
+//
+
+
+// includes
+
+#include <string.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <util/crc16.h>
+
+#include <inttypes.h>
+
+#include "global.h"
+#include "uart.h"
+#include "processPulse.h"
+#include "decFormat.h"
+#include "reportFrame.h"
+#include "profiler.h"
+
+extern uint32_t totalPulseCount;
+extern uint32_t minTimerTicks;
+
+uint8_t reportFormat;
+
+/*Sequence number of the next snapshot*/
+static uint8_t reportSeq;
+
+/*The rendered report, ready to go out as it is, and whether it needs rendering again*/
+static uint8_t reportCache[REPORT_CACHE_SIZE];
+static uint8_t reportCacheLen;
+static BOOL reportStale = TRUE;
+
+
+static uint8_t *reportPutLE(uint8_t *p, uint32_t value, uint8_t size);
+static uint32_t reportTicks24(uint32_t ticks);
+static uint8_t reportRenderFrame(uint8_t *out);
+static uint8_t reportRenderCsv(char *out);
+
+
+
+/*Store the low size bytes of value at p, least significant first. Returns the next free byte*/
+static uint8_t *reportPutLE(uint8_t *p, uint32_t value, uint8_t size)
+{
+	while(size--)
+	{
+		*p++ = (uint8_t)value;
+		value >>= 8;
+	}
+
+	return p;
+}
+
+
+
+/*Saturate an interval to the 24 bits it gets in the frame*/
+static uint32_t reportTicks24(uint32_t ticks)
+{
+	return (ticks > 0xFFFFFFUL) ? 0xFFFFFFUL : ticks;
+}
+
+
+
+/*Render the binary frame into out, returns its length on the wire*/
+static uint8_t reportRenderFrame(uint8_t *out)
+{
+	uint8_t raw[REPORT_FRAME_RAW];
+	uint8_t *p;
+	uint16_t crc;
+	uint8_t i;
+	uint8_t code;
+	uint8_t codeIndex;
+
+	p = raw;
+	*p++ = reportSeq;
+	p = reportPutLE(p, totalPulseCount, 4);
+	p = reportPutLE(p, reportTicks24(intervalAvgTicks()), 3);
+	p = reportPutLE(p, reportTicks24(minTimerTicks), 3);
+	p = reportPutLE(p, reportTicks24(intervalEmaTicks()), 3);
+
+	crc = 0xFFFF;
+	for(i=0;i<REPORT_FRAME_PAYLOAD;i++)
+	{
+		crc = _crc_ccitt_update(crc, raw[i]);
+	}
+	reportPutLE(p, crc, 2);
+
+	/*COBS encode. Each zero byte is replaced by the distance to the next zero, with the first
+	code byte saying where the first zero was. The frame is far shorter than the 254 byte COBS
+	block so there is only ever one block, and the end of the frame counts as a zero*/
+	p = out;
+	*p++ = 0;
+
+	codeIndex = 0;
+	while(codeIndex <= REPORT_FRAME_RAW)
+	{
+		/*Find the next zero, or the end of the frame*/
+		code = 1;
+		while( ((codeIndex + code - 1) < REPORT_FRAME_RAW) && (raw[codeIndex + code - 1] != 0) )
+		{
+			code++;
+		}
+
+		*p++ = code;
+		for(i=1;i<code;i++)
+		{
+			*p++ = raw[codeIndex + i - 1];
+		}
+
+		codeIndex += code;
+	}
+
+	*p++ = 0;
+
+	return p - out;
+}
+
+
+
+/*Render the CSV line into out, returns its length. out must have room for REPORT_CSV_MAX
+characters plus the terminator decFormat() writes*/
+static uint8_t reportRenderCsv(char *out)
+{
+	char *p;
+
+	strcpy_P(out, PSTR("totalTicks,"));
+	p = out + strlen(out);
+	/*totalPulseCount can be directly converted to total kWh consumed, just divide by 1600*/
+	p = decFormat(p, totalPulseCount, 0, 0);
+	*p++ = ',';
+	/*The average number of timer ticks (each tick currently configured to happen every 1/3600 sec),
+	between rising edges of the power meter LED pulse input to the AVR, over the last averageWindow pulses*/
+	p = decFormat(p, intervalAvgTicks(), 0, 0);
+	*p++ = ',';
+	/*minTimerTicks keeps track of the minimum interval (in integer numbers of 1/3600 sec) measured between Power Meter
+	LED flashes. This would correspond to a time of maximum household power draw. Currently this value is an 'all time'
+	minimum value, i.e the minimum since the last AVR reset or counter reset. This may not be particularly useful as
+	the PC logging app could keep track of such things, particularly if we also output the current non averaged
+	instantaneous pulse interval measurement too*/
+	p = decFormat(p, minTimerTicks, 0, 0);
+	*p++ = ',';
+	/*Exponentially weighted average of the interval, responds to load changes more smoothly
+	than the boxcar average*/
+	p = decFormat(p, intervalEmaTicks(), 0, 0);
+	*p++ = ',';
+	/*Instantaneous power from the averaged interval, and energy consumed since the last reset*/
+	p = decFormat(p, powerKWX100(), 0, 2);
+	*p++ = ',';
+	p = decFormat(p, energyKWhX100(), 0, 2);
+	*p++ = '\r';
+	*p++ = '\n';
+
+	return p - out;
+}
+
+
+
+void reportInvalidate()
+{
+	reportStale = TRUE;
+}
+
+
+
+uint8_t reportUpdate()
+{
+	if(!reportStale)
+	{
+		return FALSE;
+	}
+
+	PROFILE_BEGIN(PROF_REPORT_RENDER);
+
+	if(reportFormat == REPORT_FORMAT_BINARY)
+	{
+		reportCacheLen = reportRenderFrame(reportCache);
+	}
+	else
+	{
+		reportCacheLen = reportRenderCsv((char *)reportCache);
+	}
+
+	reportSeq++;
+	reportStale = FALSE;
+
+	PROFILE_END(PROF_REPORT_RENDER);
+
+	return TRUE;
+}
+
+
+
+uint8_t reportLength()
+{
+	reportUpdate();
+	return reportCacheLen;
+}
+
+
+
+void reportSend()
+{
+	uint8_t sent;
+	PROFILE_BEGIN(PROF_REPORT_SEND);
+
+	reportUpdate();
+
+	/*All in one go if there's room, anything that doesn't fit waits its turn*/
+	sent = uart_write(reportCache, reportCacheLen);
+	while(sent < reportCacheLen)
+	{
+		uart_putc(reportCache[sent++]);
+	}
+	PROFILE_END(PROF_REPORT_SEND);
+}
+
+
+
+uint8_t reportPush()
+{
+	uint8_t sent;
+	PROFILE_BEGIN(PROF_REPORT_SEND);
+
+	reportUpdate();
+
+	/*All or nothing, part of a line or frame would spoil the next one the host reads. Never
+	waits, if there isn't room the next push carries newer measurements. Only the main loop
+	fills the transmit buffer, so once the room is there uart_write() takes the lot*/
+	sent = 0;
+	if(uart_txFree() >= reportCacheLen)
+	{
+		sent = uart_write(reportCache, reportCacheLen);
+	}
+	PROFILE_END(PROF_REPORT_SEND);
+
+	return (sent == reportCacheLen);
+}
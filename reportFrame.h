@@ -0,0 +1,109 @@
+#ifndef REPORTFRAME_H
+#define REPORTFRAME_H
+/************************************************************************
+Title:    Measurement reports, CSV lines and binary frames
+Author:   Richard Clarke <richard@clarke.biz>
+File:     $Id:  $
+Software: AVR-GCC 4.1, AVR Libc 1.4
+Hardware: ATMega328P
+License:  GNU General Public License
+
+LICENSE:
+    Copyright (C) 2009 Richard Clarke
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+************************************************************************/
+#include <inttypes.h>
+
+#include "global.h"
+
+/*Report formats, selected with the SF command*/
+#define REPORT_FORMAT_CSV		0
+#define REPORT_FORMAT_BINARY	1
+
+/*Reporting mode bits, held in commandFlags and set with the SM command. Any combination
+can be selected, with none set the node only speaks when spoken to.
+
+ON_CHANGE         push a report when an averaging window completes and the power has moved by
+                  more than reportThreshold since the last report pushed
+ON_QUERY          answer GA, which always works, the bit just records that the host polls
+SEND_TOTAL_COUNT  push a report every time an averaging window completes*/
+#define ON_CHANGE 0
+#define ON_QUERY 1
+#define SEND_TOTAL_COUNT 2
+
+#define REPORT_MODE_MASK		(_BV(ON_CHANGE) | _BV(ON_QUERY) | _BV(SEND_TOTAL_COUNT))
+
+/*Default change needed for an ON_CHANGE report, kW x 100*/
+#define REPORT_THRESHOLD_DEFAULT	10
+
+/*Binary report layout before framing, all fields little endian.
+
+ offset  size  field
+ 0       1     sequence number, see below
+ 1       4     totalPulseCount
+ 5       3     boxcar average interval, Timer1 ticks
+ 8       3     minimum interval, Timer1 ticks
+ 11      3     exponential average interval, Timer1 ticks
+ 14      2     CCITT CRC16 (initial value 0xFFFF) of bytes 0 to 13
+
+The interval fields saturate at 0xFFFFFF ticks (77 minutes), a minimum of 0xFFFFFF means no
+interval has been measured since it was last reset. kW and kWh are left for the host to work out
+from the average and the count.
+
+The sequence number is incremented each time a new report is rendered, that is once per snapshot
+after the measurements or the report settings change, not once per frame sent. A frame sent again
+from the cache, in reply to a second query say, repeats the number. A gap means snapshots the
+host never saw, either lost or overtaken by a newer one before they could be pushed.
+
+The 16 bytes are then COBS encoded, so the frame contains no zero bytes, and sent with a 0x00
+delimiter either side. The leading delimiter separates the frame from any ASCII command replies
+sent before it. 19 bytes go on the wire per report against around 60 for the CSV line*/
+#define REPORT_FRAME_PAYLOAD	14
+#define REPORT_FRAME_RAW		(REPORT_FRAME_PAYLOAD + 2)
+#define REPORT_FRAME_WIRE		(REPORT_FRAME_RAW + 3)
+
+/*Longest CSV report line that can be produced, with every field at its widest*/
+#define REPORT_CSV_MAX			80
+
+/*The report cache holds either format, plus the terminator decFormat() leaves after the last field*/
+#define REPORT_CACHE_SIZE		(REPORT_CSV_MAX + 1)
+
+/*Report format in use, REPORT_FORMAT_CSV or REPORT_FORMAT_BINARY*/
+extern uint8_t reportFormat;
+
+/*************************************************************************
+The report is rendered into a cache in the selected format once per snapshot, normally when
+processPulse() completes an averaging window, and every query until the next one is answered
+from the cache. Anything that changes what the report would say, a reset or a change of window
+or format, must call reportInvalidate(). The binary sequence number counts snapshots, so a host
+that polls twice between windows gets the same frame twice.
+
+reportInvalidate()  mark the cache out of date, nothing is rendered until it is next needed
+reportUpdate()      render the cache now if it is out of date. Called from the main loop when it
+                    has nothing else to do, so a query doesn't have to wait for the rendering.
+                    Returns TRUE if it rendered
+reportLength()      bytes the current report takes on the wire
+reportSend()        queue the current report for transmission, in one go if there is room,
+                    waiting for room otherwise. For replies to a query
+reportPush()        queue the current report without ever waiting, all of it or none of it.
+                    For unsolicited reports. Returns FALSE, having queued nothing, if there
+                    isn't room for the whole report
+**************************************************************************/
+extern void reportInvalidate(void);
+extern uint8_t reportUpdate(void);
+extern uint8_t reportLength(void);
+extern void reportSend(void);
+extern uint8_t reportPush(void);
+
+
+#endif
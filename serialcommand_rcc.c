@@ -1,259 +1,523 @@
-//
-// serialcommand.c
-//
-// Contains application level functions for validating
-// and processing serial command strings. Sits above the 
-// lower level UART ring buffer and interrupt service routines.
-//
-// Author: Richard C Clarke
-// Date: March 2009
-//
-
-
-// includes
-
-#include <stdlib.h>
-#include <avr/io.h>
-#include <avr/pgmspace.h>
-
-#include <avr/interrupt.h>
-#include <avr/sleep.h>
-#include <inttypes.h>
-
-#include "global.h"
-#include "timer.h"
-
-#include "uart.h"		// include uart function library
-#include "serialcommand_rcc.h"
-
-
-static uint8_t cmdLength;
-uint8_t linearBuffer[12];
-
-/*************************************************************************
-Function: uart_getCmd( char *cmdBuf )
-Purpose:  return command string from ringbuffer  
-Arguments: pointer to the command value location into which to place the numerical payload
-Returns:  number of characters in the serial command.
-
-		  Expected serial command format is, !SC:XXXX#
-where '!' marks the start of a valid command, 'SC' is a 2 character command type, ':' is the 
-command type and command value seperator, and XXXX is a ascii representation of a 16 bit hex 
-value, and '#' marks end of command string. Thus, including the NULL terminator that the RX
-ISR inserts, a valid command should have a length of 11 bytes.
-
-Later on may add CRC information for validation of error free reception, useful when use RF link
-*/
-/**************************************************************************/
-
-#if 0
-uint8_t sc_getCmd()
-{
-	unsigned int cmdInt;
-	uint8_t index = 0;
-	unsigned char *cmdBuf;
-
-	cmdBuf = gbuffer;
-
-	do
-	{
-		cmdInt = uart_getc();
-		*(cmdBuf + index) = 0xFF & cmdInt;
-		index++;
-	}while(cmdInt != UART_NO_DATA);
-
-	/*Reduce count by 1 as don't want the increment that occurred when cmdInt = UART_NO_DATA*/
-	index--;
-
-	cmdLength = index;
-
-	/*Re-enable the rx uart interrupt*/
-	
-	UART0_CONTROL |= 1<<RXCIE;
-
-	return index;
-}
-
-#else
-
-uint8_t sc_getCmd()
-{
-	uint16_t cmdInt;
-	uint8_t index = 0;
-
-	/*Stop the receive interrupt, until we've transferred the received '\r' terminated
-	 serial string out of the ring buffer into the linear command buffer*/
-	UART0_CONTROL |= 0<<RXCIE;
-
-	do
-	{
-		cmdInt = uart_getc();
-		linearBuffer[index] = 0xFF & cmdInt;
-		index++;
-	}while(cmdInt != UART_NO_DATA);
-
-	/*Reduce count by 1 as don't want the increment that occurred when cmdInt = UART_NO_DATA*/
-	index--;
-
-	/*Re-enable the rx uart interrupt*/
-	UART0_CONTROL |= 1<<RXCIE;
-	
-
-	cmdLength = index;
-	return index;
-}
-
-#endif
-
-#if 1
-/*Each element of defined command format corresponds to 1 state in state machine.
-Elements include: length of command, start character, field seperator character and it's position,
-end of command character
-*/
-enum cmdResult_t sc_validateCmd(uint8_t *cmdType, uint16_t *cmdValue)
-{
-	enum cmdState_t cmdState;
-	enum cmdResult_t cmdResult;
-
-	cmdState = CHK_CMDLEN;
-	cmdResult = CMD_INVALID;
-
-	while(cmdState != CHK_FINISH)
-	{
-		switch(cmdState)
-		{
-			case CHK_CMDLEN:
-				if (cmdLength != VALID_CMD_LEN)
-				{
-					
-					cmdState = CHK_FINISH;
-					//uart_puts_P("A\r\n");
-				}
-				else
-				{
-					
-					cmdState = CHK_STARTCHAR;
-					//uart_puts_P("B\r\n");
-				}
-				break;
-
-			case CHK_STARTCHAR:
-				if(linearBuffer[START_CHAR_POS] != START_CHAR)
-				{
-					
-					cmdState = CHK_FINISH;
-					//uart_puts_P("C\r\n");
-				}
-				else
-				{
-					
-					cmdState = CHK_SEPERATOR;
-					//uart_puts_P("D\r\n");
-				}
-				break;
-
-			case CHK_SEPERATOR:
-				if(linearBuffer[SEPERATOR_CHAR_POS] != SEPERATOR_CHAR)
-				{
-					
-					cmdState = CHK_FINISH;
-					//uart_puts_P("E\r\n");
-				}
-				else
-				{
-					
-					cmdState = CHK_ENDCHAR;
-					//uart_puts_P("F\r\n");
-				}
-				break;
-
-			case CHK_ENDCHAR:
-				if(linearBuffer[END_CHAR_POS] != END_CHAR)
-				{
-					
-					cmdState = CHK_FINISH;
-					//uart_puts_P("G\r\n");
-				}
-				else
-				{
-					
-					cmdResult = CMD_VALID;
-					cmdState = EXTRACT_FIELDS;
-					/*Make the end character a NULL so that the value field can be treated as a string
-					by the function atol() when extracting the fields*/
-					//linearBuffer[END_CHAR_POS] = 0x0;
-					//uart_puts_P("H\r\n");
-				}
-				break;
-
-			case EXTRACT_FIELDS:
-				*cmdType = linearBuffer[CMD_TYPE_CHAR_1_POS];
-				*(cmdType+1) = linearBuffer[CMD_TYPE_CHAR_2_POS];
-			/*	*cmdValue = atol(&linearBuffer[CMD_VALUE_CHAR_1_POS]);*/
-			/*	*cmdValue = (uint16_t)strtoul(&linearBuffer[CMD_VALUE_CHAR_1_POS],NULL,16);*/
-			/*	*cmdValue = asciiHexToUint(&linearBuffer[CMD_VALUE_CHAR_1_POS]);
-				*cmdValue = asciiHexToUint(&linearBuffer[CMD_VALUE_CHAR_3_POS]);*/
-
-
-				cmdState = CHK_FINISH;
-				//uart_puts_P("I\r\n");
-				break;
-			default:
-				break;
-		}
-	}/*end while*/
-
-	return cmdResult;
-}
-
-#endif
-
-
-uint8_t asciiHexToUint(uint8_t *s)
-{
-	uint8_t i;
-	uint8_t tempByte = 0;
-	//uint16_t resultInt = 0;
-
-
-#if 1
-	for(i=0;i<2;i++)
-	{
-		/*Does this character represent a numeric value betwee 0 and 9?*/
-		if( *(s+i) < 0x3A)
-		{
-			
-			//resultInt = resultInt | ( (*(s+i) - 0x30) << (12 - 4*i) );
-			uart_puts_P("D\r\n");
-			//uart_putc(*(s+i));
-			
-		}
-		else
-		{
-			if( *(s+i) > 0x40 )
-			{
-				/*Assume for the moment then that it must be a letter between A and F*/
-				//resultInt = resultInt | ( (*(s+i) - 0x41) << (12 - 4*i) );
-				uart_puts_P("H\r\n");
-				//uart_putc(*(s+i));
-			
-			}
-			else
-			{
-				uart_puts_P("O\r\n");
-			}
-		}
-		//uart_putc(*(s+i));
-	}
-#endif
-	/*uart_putc(*s);
-	uart_putc(*(s+1));
-	uart_putc(*(s+2));
-	uart_putc(*(s+3));*/
-
-
-	return tempByte;
-}
-
-
-		
+//
+// serialcommand.c
+//
+// Contains application level functions for framing, validating
+// and processing serial command strings. The framing runs in the
+// UART receive interrupt, a byte at a time.
+//
+// Author: Richard C Clarke
+// Date: March 2009
+//
+
+
+// includes
+
+#include <stdlib.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <util/crc16.h>
+
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <inttypes.h>
+
+#include "global.h"
+#include "timer.h"
+
+#include "uart.h"		// include uart function library
+#include "serialcommand_rcc.h"
+
+
+/*Command line being framed by sc_parseByte(), and where it has got to*/
+static struct serialCmd_t cmdWork;
+static uint8_t cmdState;
+static uint8_t cmdDigits;
+
+/*CRC of a sequenced frame, worked out as it arrives and as received*/
+static uint16_t cmdCrc;
+static uint16_t cmdCrcRx;
+
+#if RS485_MULTIDROP
+/*Address the node answers to, and whether the line being framed is for it*/
+static volatile uint8_t cmdNodeAddress = CMD_ADDR_DEFAULT;
+static uint8_t cmdAddress;
+static BOOL cmdAddressed;
+#endif
+
+/*Single producer, single consumer ring of received commands. Only the receive ISR writes
+cmdQueueHead and only sc_getCmd() and sc_flush() write cmdQueueTail. One slot is always left empty*/
+static volatile struct serialCmd_t cmdQueue[CMD_QUEUE_SIZE];
+static volatile uint8_t cmdQueueHead;
+static volatile uint8_t cmdQueueTail;
+static volatile uint16_t cmdQueueOverflows;
+
+/*Replay cache, the last sequenced request carried out and the reply it got, up to and including
+the sequence number in its trailer. replyCrc covers the same bytes*/
+static BOOL replyValid;
+static uint8_t replySeq;
+static uint8_t replyCode[2];
+static uint16_t replyValue;
+static enum cmdResult_t replyResult;
+static uint8_t replyCache[CMD_REPLAY_SIZE];
+static uint8_t replyLen;
+static BOOL replyOverflow;
+static uint16_t replyCrc;
+
+
+static uint8_t hexDigit(uint8_t c);
+static void putHex(uint16_t value, uint8_t digits);
+static void replyTap(unsigned char c);
+
+
+
+/*Value of an ascii hex digit, upper or lower case, or 0xFF if c isn't one*/
+static uint8_t hexDigit(uint8_t c)
+{
+	/*Does this character represent a numeric value between 0 and 9?*/
+	if( (c >= '0') && (c <= '9') )
+	{
+		return c - '0';
+	}
+
+	/*Fold lower case onto upper case, then check for a letter between A and F*/
+	c = c & ~0x20;
+	if( (c >= 'A') && (c <= 'F') )
+	{
+		return c - 'A' + 10;
+	}
+
+	return 0xFF;
+}
+
+
+
+/*Send the low digits hex digits of value, upper case*/
+static void putHex(uint16_t value, uint8_t digits)
+{
+	uint8_t digit;
+
+	while(digits--)
+	{
+		digit = (value >> (digits << 2)) & 0x0F;
+		uart_putc( (digit < 10) ? ('0' + digit) : ('A' - 10 + digit) );
+	}
+}
+
+
+
+/*Sees every byte of a sequenced reply on its way into the transmit buffer, see uart_setTxTap()*/
+static void replyTap(unsigned char c)
+{
+	replyCrc = _crc_ccitt_update(replyCrc, c);
+
+	if(replyLen < CMD_REPLAY_SIZE)
+	{
+		replyCache[replyLen++] = c;
+	}
+	else
+	{
+		replyOverflow = TRUE;
+	}
+}
+
+
+
+/*Each element of the command format corresponds to 1 state in the state machine. A byte that
+doesn't fit the frame sends it to DISCARD, which waits out the rest of the line so it can still be
+answered with IV. Nothing is buffered, the type and value are picked out as they go past*/
+void sc_parseByte(uint8_t c, uint8_t rxError)
+{
+	uint8_t tmphead;
+	uint8_t digit;
+
+	if(c == '\r')
+	{
+#if RS485_MULTIDROP
+		/*Not for this node, or too garbled to tell, so not a word in reply*/
+		if(!cmdAddressed)
+		{
+			cmdState = CHK_STARTCHAR;
+			return;
+		}
+		cmdAddressed = FALSE;
+#endif
+
+		/*End of line, queue the command good or bad*/
+		if( (cmdState != CHK_EOL) || rxError )
+		{
+			cmdWork.result = CMD_INVALID;
+		}
+		else
+		{
+			cmdWork.result = CMD_VALID;
+		}
+		cmdState = CHK_STARTCHAR;
+
+		tmphead = (cmdQueueHead + 1) & CMD_QUEUE_MASK;
+		if(tmphead == cmdQueueTail)
+		{
+			cmdQueueOverflows++;
+			return;
+		}
+		cmdQueue[tmphead].code[0] = cmdWork.code[0];
+		cmdQueue[tmphead].code[1] = cmdWork.code[1];
+		cmdQueue[tmphead].value = cmdWork.value;
+		cmdQueue[tmphead].result = cmdWork.result;
+		cmdQueue[tmphead].sequenced = cmdWork.sequenced;
+		cmdQueue[tmphead].seq = cmdWork.seq;
+#if RS485_MULTIDROP
+		cmdQueue[tmphead].broadcast = (cmdAddress == CMD_ADDR_BROADCAST);
+#endif
+
+		/*Publish the entry only once it has been completely written*/
+		cmdQueueHead = tmphead;
+		return;
+	}
+
+	if(rxError)
+	{
+		cmdState = DISCARD;
+		return;
+	}
+
+	/*Everything after the '!' up to the '*' goes into the CRC*/
+	if( (cmdState > CHK_STARTCHAR) && (cmdState <= GET_SEQ) )
+	{
+		cmdCrc = _crc_ccitt_update(cmdCrc, c);
+	}
+
+	switch(cmdState)
+	{
+		case CHK_STARTCHAR:
+			if(c == START_CHAR)
+			{
+				cmdWork.value = 0;
+				cmdWork.sequenced = FALSE;
+				cmdDigits = 0;
+				cmdCrc = _crc_ccitt_update(0xFFFF, c);
+#if RS485_MULTIDROP
+				cmdAddress = 0;
+				cmdState = GET_ADDR;
+#else
+				cmdState = GET_TYPE_1;
+#endif
+			}
+			else if(c != '\n')
+			{
+				cmdState = DISCARD;
+			}
+			break;
+
+#if RS485_MULTIDROP
+		case GET_ADDR:
+			digit = hexDigit(c);
+			if(digit > 0x0F)
+			{
+				cmdState = DISCARD;
+				break;
+			}
+			cmdAddress = (cmdAddress << 4) | digit;
+			if(++cmdDigits >= CMD_ADDR_DIGITS)
+			{
+				cmdDigits = 0;
+				cmdState = CHK_ADDR_SEPERATOR;
+			}
+			break;
+
+		case CHK_ADDR_SEPERATOR:
+			if(c != ADDR_SEPERATOR_CHAR)
+			{
+				cmdState = DISCARD;
+				break;
+			}
+			/*From here on a bad frame is answered with IV, as it is known to be for this node*/
+			if( (cmdAddress == cmdNodeAddress) || (cmdAddress == CMD_ADDR_BROADCAST) )
+			{
+				cmdAddressed = TRUE;
+				cmdState = GET_TYPE_1;
+			}
+			else
+			{
+				cmdState = DISCARD;
+			}
+			break;
+#endif
+
+		case GET_TYPE_1:
+			cmdWork.code[0] = c;
+			cmdState = GET_TYPE_2;
+			break;
+
+		case GET_TYPE_2:
+			cmdWork.code[1] = c;
+			cmdState = CHK_SEPERATOR;
+			break;
+
+		case CHK_SEPERATOR:
+			cmdState = (c == SEPERATOR_CHAR) ? GET_VALUE : DISCARD;
+			break;
+
+		case GET_VALUE:
+			digit = hexDigit(c);
+			if(digit > 0x0F)
+			{
+				cmdState = DISCARD;
+				break;
+			}
+			cmdWork.value = (cmdWork.value << 4) | digit;
+			if(++cmdDigits >= CMD_VALUE_DIGITS)
+			{
+				cmdState = CHK_ENDCHAR;
+			}
+			break;
+
+		case CHK_ENDCHAR:
+			if(c == END_CHAR)
+			{
+				cmdState = CHK_EOL;
+			}
+			else if(c == SEQ_SEPERATOR_CHAR)
+			{
+				cmdWork.seq = 0;
+				cmdDigits = 0;
+				cmdState = GET_SEQ;
+			}
+			else
+			{
+				cmdState = DISCARD;
+			}
+			break;
+
+		case GET_SEQ:
+			digit = hexDigit(c);
+			if(digit > 0x0F)
+			{
+				cmdState = DISCARD;
+				break;
+			}
+			cmdWork.seq = (cmdWork.seq << 4) | digit;
+			if(++cmdDigits >= CMD_SEQ_DIGITS)
+			{
+				cmdState = CHK_CRCCHAR;
+			}
+			break;
+
+		case CHK_CRCCHAR:
+			cmdCrcRx = 0;
+			cmdDigits = 0;
+			cmdState = (c == CRC_CHAR) ? GET_CRC : DISCARD;
+			break;
+
+		case GET_CRC:
+			digit = hexDigit(c);
+			if(digit > 0x0F)
+			{
+				cmdState = DISCARD;
+				break;
+			}
+			cmdCrcRx = (cmdCrcRx << 4) | digit;
+			if(++cmdDigits >= CMD_CRC_DIGITS)
+			{
+				cmdState = CHK_SEQ_ENDCHAR;
+			}
+			break;
+
+		case CHK_SEQ_ENDCHAR:
+			/*A frame that fails its CRC is no better than any other garbled line*/
+			if( (c == END_CHAR) && (cmdCrcRx == cmdCrc) )
+			{
+				cmdWork.sequenced = TRUE;
+				cmdState = CHK_EOL;
+			}
+			else
+			{
+				cmdState = DISCARD;
+			}
+			break;
+
+		case CHK_EOL:
+		case DISCARD:
+		default:
+			/*Anything between the end of the frame and the '\r' spoils it*/
+			cmdState = DISCARD;
+			break;
+	}
+}
+
+
+
+uint8_t sc_getCmd(struct serialCmd_t *cmd)
+{
+	uint8_t tmptail;
+
+	if(cmdQueueHead == cmdQueueTail)
+	{
+		return FALSE;
+	}
+
+	tmptail = (cmdQueueTail + 1) & CMD_QUEUE_MASK;
+	cmd->code[0] = cmdQueue[tmptail].code[0];
+	cmd->code[1] = cmdQueue[tmptail].code[1];
+	cmd->value = cmdQueue[tmptail].value;
+	cmd->result = cmdQueue[tmptail].result;
+	cmd->sequenced = cmdQueue[tmptail].sequenced;
+	cmd->seq = cmdQueue[tmptail].seq;
+#if RS485_MULTIDROP
+	cmd->broadcast = cmdQueue[tmptail].broadcast;
+#endif
+
+	/*Hand the slot back to the ISR only once it has been read*/
+	cmdQueueTail = tmptail;
+
+	return TRUE;
+}
+
+
+
+void sc_flush(void)
+{
+	uint8_t sreg;
+
+	sreg = SREG;
+	cli();
+	cmdQueueTail = cmdQueueHead;
+	cmdState = CHK_STARTCHAR;
+#if RS485_MULTIDROP
+	cmdAddressed = FALSE;
+#endif
+	SREG = sreg;
+}
+
+
+
+uint8_t sc_cmdAvailable(void)
+{
+	return (cmdQueueHead != cmdQueueTail);
+}
+
+
+
+uint16_t sc_getOverflows(void)
+{
+	uint16_t overflows;
+
+	cli();
+	overflows = cmdQueueOverflows;
+	sei();
+
+	return overflows;
+}
+
+
+
+#if RS485_MULTIDROP
+void sc_setAddress(uint8_t address)
+{
+	cmdNodeAddress = address;
+}
+#endif
+
+
+
+enum cmdResult_t sc_execute(const struct cmdEntry_t *table, uint8_t entries,
+							struct serialCmd_t *cmd)
+{
+	uint8_t i;
+
+	if(cmd->result != CMD_VALID)
+	{
+		uart_puts_P("IV\r\n");
+		return CMD_INVALID;
+	}
+
+	/*A broadcast goes out muted, so there is no reply to keep. Recording it would leave a unicast
+	retry of the same sequence number to be answered from an empty cache*/
+#if RS485_MULTIDROP
+	if(!cmd->sequenced || cmd->broadcast)
+#else
+	if(!cmd->sequenced)
+#endif
+	{
+		return sc_dispatch(table, entries, &cmd->code[0], cmd->value);
+	}
+
+	/*A retry of the last request, repeat the reply rather than doing it all again. A reply too
+	long to have been kept can only have come from a Get command, which is safe to run again*/
+	if( replyValid && (replyLen != 0) && !replyOverflow && (cmd->seq == replySeq) &&
+		(cmd->code[0] == replyCode[0]) && (cmd->code[1] == replyCode[1]) && (cmd->value == replyValue) )
+	{
+		for(i=0;i<replyLen;i++)
+		{
+			uart_putc(replyCache[i]);
+		}
+	}
+	else
+	{
+		replyValid = FALSE;
+		replyLen = 0;
+		replyOverflow = FALSE;
+		replyCrc = 0xFFFF;
+
+		uart_setTxTap(replyTap);
+		replyResult = sc_dispatch(table, entries, &cmd->code[0], cmd->value);
+		uart_putc(REPLY_TRAILER_CHAR);
+		putHex(cmd->seq, CMD_SEQ_DIGITS);
+		uart_setTxTap(NULL);
+
+		replySeq = cmd->seq;
+		replyCode[0] = cmd->code[0];
+		replyCode[1] = cmd->code[1];
+		replyValue = cmd->value;
+		replyValid = TRUE;
+	}
+
+	uart_putc(CRC_CHAR);
+	putHex(replyCrc, CMD_CRC_DIGITS);
+	uart_puts_P("\r\n");
+
+	return replyResult;
+}
+
+
+
+enum cmdResult_t sc_dispatch(const struct cmdEntry_t *table, uint8_t entries,
+							uint8_t *cmdType, uint16_t cmdValue)
+{
+	struct cmdEntry_t entry;
+	uint8_t i;
+
+	/*Linear search, comparing the code bytes straight out of flash and only copying the whole
+	entry into RAM once it has been found*/
+	for(i=0;i<entries;i++)
+	{
+		if( (pgm_read_byte(&table[i].code[0]) == cmdType[0]) &&
+			(pgm_read_byte(&table[i].code[1]) == cmdType[1]) )
+		{
+			break;
+		}
+	}
+
+	if(i >= entries)
+	{
+		uart_puts_P("IV\r\n");
+		return CMD_INVALID;
+	}
+
+	memcpy_P(&entry, &table[i], sizeof(struct cmdEntry_t));
+
+	if( (cmdValue < entry.min) || (cmdValue > entry.max) || !entry.handler(cmdValue) )
+	{
+		uart_puts_P("IV\r\n");
+		return CMD_INVALID;
+	}
+
+	if(entry.flags & CMD_ACK)
+	{
+		uart_putc(entry.code[0]);
+		uart_putc(entry.code[1]);
+		uart_putc('\r');
+	}
+
+	return CMD_VALID;
+}
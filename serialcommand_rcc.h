@@ -1,93 +1,214 @@
-#ifndef SERIALCOMMAND_H
-#define SERIALCOMMAND_H
-/************************************************************************
-Title:    Serial Command validation and processing
-Author:   Richard Clarke <richard@clarke.biz>   
-File:     $Id:  $
-Software: AVR-GCC 4.1, AVR Libc 1.4
-Hardware: any AVR with built-in UART, tested on ATTiny2313 
-License:  GNU General Public License 
-Usage:    see Doxygen manual
-
-LICENSE:
-    Copyright (C) 2009 Richard Clarke
-
-    This program is free software; you can redistribute it and/or modify
-    it under the terms of the GNU General Public License as published by
-    the Free Software Foundation; either version 2 of the License, or
-    any later version.
-
-    This program is distributed in the hope that it will be useful,
-    but WITHOUT ANY WARRANTY; without even the implied warranty of
-    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
-    GNU General Public License for more details.
-    
-************************************************************************/
-#include "global.h"
-
-#define VALID_CMD_LEN 10
-
-enum cmdState_t
-{
-	
-	CHK_CMDLEN,
-	CHK_STARTCHAR,
-	CHK_SEPERATOR,
-	CHK_ENDCHAR,
-	EXTRACT_FIELDS,
-	CHK_FINISH
-	
-};
-
-
-/*Define structure of valid command string*/
-#define START_CHAR_POS 			0
-#define CMD_TYPE_CHAR_1_POS 	1
-#define CMD_TYPE_CHAR_2_POS 	2
-#define SEPERATOR_CHAR_POS		3
-#define CMD_VALUE_CHAR_1_POS	4
-#define CMD_VALUE_CHAR_2_POS	5
-#define CMD_VALUE_CHAR_3_POS	6
-#define CMD_VALUE_CHAR_4_POS	7
-#define END_CHAR_POS			8
-
-
-enum cmdResult_t
-{
-	CMD_INVALID,
-	CMD_VALID
-};
-
-#define START_CHAR '!'		/* dec 33, 0x21*/
-#define SEPERATOR_CHAR ':'
-#define END_CHAR '#'
-
-/*TODO:USER:RCC
-**User added function for transferring a '\r' terminated serial command from the uart circular buffer
-**to a linear command buffer for validation and processing
-*/
-
-
-/*************************************************************************
-Function: sc_getCmd( char *cmdBuf )
-Purpose:  return command string from ringbuffer  
-Arguments: pointer to the command value location into which to place the numerical payload
-Returns:  number of characters in the serial command.
-
-		  Expected serial command format is, !SC:XXXX#
-where '!' marks the start of a valid command, 'SC' is a 2 character command type, ':' is the 
-command type and command value seperator, and XXXX is a ascii representation of a 16 bit hex 
-value, and '#' marks end of command string. Thus, including the NULL terminator that the RX
-ISR inserts, a valid command should have a length of 10 bytes.
-
-Later on may add CRC information for validation of error free reception, useful when use RF link
-*/
-/**************************************************************************/
-extern uint8_t sc_getCmd(void);
-
-enum cmdResult_t sc_validateCmd(uint8_t *cmdType, uint16_t *cmdValue);
-
-extern uint8_t asciiHexToUint(uint8_t *s);
-
-
-#endif
+#ifndef SERIALCOMMAND_H
+#define SERIALCOMMAND_H
+/************************************************************************
+Title:    Serial Command validation and processing
+Author:   Richard Clarke <richard@clarke.biz>   
+File:     $Id:  $
+Software: AVR-GCC 4.1, AVR Libc 1.4
+Hardware: any AVR with built-in UART, tested on ATTiny2313 
+License:  GNU General Public License 
+Usage:    see Doxygen manual
+
+LICENSE:
+    Copyright (C) 2009 Richard Clarke
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    
+************************************************************************/
+#include "global.h"
+#include "uart.h"
+
+/*Command frame. Expected serial command format is, !SC:XXXX#\r
+where '!' marks the start of a valid command, 'SC' is a 2 character command type, ':' is the 
+command type and command value seperator, XXXX is a ascii representation of a 16 bit hex value
+(either case), '#' marks end of command and '\r' ends the line. A '\n' between lines is ignored.
+
+Sequenced frame, for lossy links such as radio or long cable runs. !SC:XXXX,QQ*CCCC#\r where QQ is
+a sequence number as 2 hex digits, and CCCC is the CCITT CRC16 (initial value 0xFFFF) of every
+character from the '!' up to but not including the '*', as 4 hex digits. A frame with a bad CRC is
+answered with IV. The host uses a new sequence number for each new request and the same one when
+it retries a request it got no good reply to.
+
+The reply to a sequenced frame is the command's usual reply followed by a trailer line,
+~QQ*CCCC\r\n, where QQ is the request's sequence number and CCCC the CRC16 of the whole reply
+from its first byte up to but not including the '*'. The node remembers the last sequenced request
+it carried out. If the same request arrives again it is not carried out again, the reply already
+sent is repeated byte for byte, so a retried RA resets once and a retried GA returns the same
+snapshot. Only replies of up to CMD_REPLAY_SIZE bytes can be repeated, longer ones (the Get commands
+that list histograms or the log, which change nothing) are generated again.
+
+Unsequenced frames are still accepted and replied to as before, and don't disturb the replay cache*/
+#define START_CHAR '!'		/* dec 33, 0x21*/
+#define SEPERATOR_CHAR ':'
+#define END_CHAR '#'
+#define CMD_VALUE_DIGITS	4
+
+#define SEQ_SEPERATOR_CHAR	','
+#define CRC_CHAR			'*'
+#define REPLY_TRAILER_CHAR	'~'
+#define CMD_SEQ_DIGITS		2
+#define CMD_CRC_DIGITS		4
+
+/*Bytes of the last reply kept for repeating it, including the start of its trailer*/
+#ifndef CMD_REPLAY_SIZE
+#define CMD_REPLAY_SIZE		88
+#endif
+
+/*Addressed frame, for RS485_MULTIDROP builds. !AA/SC:XXXX#\r where AA is the node address as 2
+hex digits and the rest is as above. Every frame on a multidrop bus must carry an address. A node
+only acts on frames carrying its own address or CMD_ADDR_BROADCAST, and only replies to its own
+address, so a broadcast (a reset, say, or SB to move the whole bus to a new rate) is carried out
+silently by every node. A sequenced broadcast is not kept in the replay cache, so a later
+addressed retry of it is carried out again and answered. Lines it can't find its address in, including garbled ones and the replies
+of other nodes, are ignored altogether, there is no IV for them as every node would send one.
+
+The node doesn't take the bus to reply until RS485_TURNAROUND_BITS bit times after the end of the
+command, however quickly the reply is ready, so the host has that long to release it. The node
+releases the bus at the end of the stop bit of its last byte, see RS485_MULTIDROP in uart.h*/
+#define ADDR_SEPERATOR_CHAR	'/'
+#define CMD_ADDR_DIGITS		2
+#define CMD_ADDR_BROADCAST	0xFF
+#define CMD_ADDR_DEFAULT	0x00
+
+/*States of the command framing state machine, one per element of the frame*/
+enum cmdState_t
+{
+	CHK_STARTCHAR,
+	GET_ADDR,				/*CMD_ADDR_DIGITS hex digits, RS485_MULTIDROP only*/
+	CHK_ADDR_SEPERATOR,
+	GET_TYPE_1,
+	GET_TYPE_2,
+	CHK_SEPERATOR,
+	GET_VALUE,				/*CMD_VALUE_DIGITS hex digits*/
+	CHK_ENDCHAR,			/*or the start of a sequence number*/
+	GET_SEQ,				/*CMD_SEQ_DIGITS hex digits*/
+	CHK_CRCCHAR,
+	GET_CRC,				/*CMD_CRC_DIGITS hex digits*/
+	CHK_SEQ_ENDCHAR,
+	CHK_EOL,				/*complete frame, only the '\r' can follow*/
+	DISCARD					/*bad frame, skip to the '\r'*/
+};
+
+
+enum cmdResult_t
+{
+	CMD_INVALID,
+	CMD_VALID
+};
+
+/*One received command line, as queued by sc_parseByte()*/
+struct serialCmd_t
+{
+	uint8_t code[2];			/*2 character command type*/
+	uint16_t value;
+	enum cmdResult_t result;	/*CMD_INVALID if the line wasn't a well formed command*/
+	uint8_t sequenced;			/*TRUE if the frame carried a sequence number and good CRC*/
+	uint8_t seq;
+#if RS485_MULTIDROP
+	uint8_t broadcast;			/*TRUE if sent to CMD_ADDR_BROADCAST, the node mustn't reply*/
+#endif
+};
+
+/*Number of received commands that can be waiting for the main loop. Must be a power of 2, one
+slot is always kept empty, so the default holds 3 pipelined commands*/
+#ifndef CMD_QUEUE_SIZE
+#define CMD_QUEUE_SIZE		4
+#endif
+#define CMD_QUEUE_MASK		(CMD_QUEUE_SIZE - 1)
+
+#if (CMD_QUEUE_SIZE & CMD_QUEUE_MASK)
+#error CMD_QUEUE_SIZE is not a power of 2
+#endif
+
+
+/*************************************************************************
+Function: sc_parseByte()
+Purpose:  feed one received byte to the command framing state machine. Each
+		  '\r' completes a line, which is queued as a serialCmd_t for the main
+		  loop whether it was a good command or not. Called from the UART
+		  receive ISR.
+Arguments: c, the byte received
+		   rxError, non zero if the UART flagged a framing or overrun error
+		   on this byte, which spoils the line it is in
+**************************************************************************/
+extern void sc_parseByte(uint8_t c, uint8_t rxError);
+
+/*************************************************************************
+Function: sc_getCmd()
+Purpose:  take the oldest received command line off the queue. Only to be
+		  called from the main loop.
+Arguments: cmd, where to put the command
+Returns:  TRUE if a command was returned, FALSE if none are waiting
+**************************************************************************/
+extern uint8_t sc_getCmd(struct serialCmd_t *cmd);
+
+/*Throw away every queued command line and any line part way through being received, so
+whatever sc_getCmd() returns next was received in full from here on*/
+extern void sc_flush(void);
+
+/*TRUE if a command line is waiting for sc_getCmd()*/
+extern uint8_t sc_cmdAvailable(void);
+
+/*Number of command lines thrown away because the queue was full*/
+extern uint16_t sc_getOverflows(void);
+
+#if RS485_MULTIDROP
+/*Set the address the node answers to, 0 to 0xFE*/
+extern void sc_setAddress(uint8_t address);
+#endif
+
+
+/*Command handler, called with the value field of the command once it has been range checked.
+Returns FALSE if the command couldn't be carried out*/
+typedef uint8_t (*cmdHandler_t)(uint16_t value);
+
+/*cmdEntry_t flags*/
+#define CMD_ACK		0x01	/*reply with the command code and '\r' when the handler succeeds*/
+
+/*One entry of a command dispatch table. Tables are kept in flash, see sc_dispatch()*/
+struct cmdEntry_t
+{
+	uint8_t code[2];			/*2 character command type, e.g. 'S','W'*/
+	uint8_t flags;
+	uint16_t min;				/*range of value fields accepted*/
+	uint16_t max;
+	cmdHandler_t handler;
+};
+
+/*************************************************************************
+Function: sc_execute()
+Purpose:  carry out a command line from sc_getCmd(). Invalid lines are answered
+		  with IV, valid ones go to sc_dispatch(). A sequenced command gets its
+		  reply trailer, and is checked against the last one carried out so a
+		  retry is answered from the replay cache instead of being run again.
+Arguments: table, entries, the command table in flash and its length
+		   cmd, the command line
+Returns:  CMD_VALID if the command was carried out and succeeded, now or when
+		  it was first received
+**************************************************************************/
+extern enum cmdResult_t sc_execute(const struct cmdEntry_t *table, uint8_t entries,
+								   struct serialCmd_t *cmd);
+
+/*************************************************************************
+Function: sc_dispatch()
+Purpose:  look up a validated command in a PROGMEM table of cmdEntry_t and
+		  run its handler. Replies IV if the command isn't in the table, the
+		  value is out of range or the handler fails.
+Arguments: table, entries, the command table in flash and its length
+		   cmdType, the 2 character command type from sc_getCmd()
+		   cmdValue, the value field from sc_getCmd()
+Returns:  CMD_VALID if the handler was run and succeeded
+**************************************************************************/
+extern enum cmdResult_t sc_dispatch(const struct cmdEntry_t *table, uint8_t entries,
+									uint8_t *cmdType, uint16_t cmdValue);
+
+
+#endif
@@ -0,0 +1,92 @@
+//
+// taskSched.c
+//
+// Calls the main loop's tasks in priority order, one piece of work
+// at a time, and keeps run time statistics against each task's budget.
+//
+// Author: Richard C Clarke
+// Date: March 2009
+//
+
+
+// includes
+
+#include <string.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+
+#include <inttypes.h>
+
+#include "global.h"
+#include "timer.h"
+#include "taskSched.h"
+
+static struct taskStats_t taskStats[SCHED_TASKS_MAX];
+
+
+
+uint8_t schedRun(const struct taskEntry_t *table, uint8_t entries)
+{
+	uint8_t i;
+	uint8_t worked;
+	uint16_t start;
+	uint16_t ticks;
+	struct taskEntry_t task;
+	struct taskStats_t *stats;
+
+	if(entries > SCHED_TASKS_MAX)
+	{
+		entries = SCHED_TASKS_MAX;
+	}
+
+	for(i=0;i<entries;i++)
+	{
+		memcpy_P(&task, &table[i], sizeof(struct taskEntry_t));
+		stats = &taskStats[i];
+
+		start = timer0GetTimestamp();
+		worked = task.run();
+		ticks = timer0GetTimestamp() - start;
+
+		/*A call that finds nothing to do is timed too, checking for work mustn't be slow either*/
+		if(ticks > stats->worst)
+		{
+			stats->worst = ticks;
+		}
+		if( (ticks > task.budget) && (stats->overruns != MAX_U16) )
+		{
+			stats->overruns++;
+		}
+
+		if(worked)
+		{
+			stats->runs++;
+
+			/*Back to the top, anything of higher priority that turned up meanwhile goes next*/
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+
+
+void schedGetStats(uint8_t index, struct taskStats_t *stats)
+{
+	*stats = taskStats[index];
+}
+
+
+
+void schedClearStats()
+{
+	uint8_t i;
+
+	for(i=0;i<SCHED_TASKS_MAX;i++)
+	{
+		taskStats[i].runs = 0;
+		taskStats[i].overruns = 0;
+		taskStats[i].worst = 0;
+	}
+}
@@ -0,0 +1,74 @@
+#ifndef TASKSCHED_H
+#define TASKSCHED_H
+/************************************************************************
+Title:    Run to completion task scheduler for the main loop
+Author:   Richard Clarke <richard@clarke.biz>
+File:     $Id:  $
+Software: AVR-GCC 4.1, AVR Libc 1.4
+Hardware: ATMega328P
+License:  GNU General Public License
+
+LICENSE:
+    Copyright (C) 2009 Richard Clarke
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+************************************************************************/
+#include <inttypes.h>
+
+#include "global.h"
+
+/*Most tasks a table can hold, each one costs 8 bytes of SRAM for its statistics*/
+#define SCHED_TASKS_MAX		8
+
+/*Task budgets are in Timer0 ticks, F_CPU/64. SCHED_US() converts from microseconds at compile
+time, a tick is 17.4us at 3.6864MHz. Budgets can be up to 65535 ticks, 1.14 sec*/
+#define SCHED_TICK_RATE		(F_CPU/64)
+#define SCHED_US(us)		((uint16_t)(((us) * (SCHED_TICK_RATE/1000UL))/1000UL))
+
+/*A task does a bounded piece of work and returns, it never waits for anything. It returns TRUE if
+it did some work, or has more to do straight away, and FALSE if it found nothing to do*/
+typedef uint8_t (*taskFunc_t)(void);
+
+/*One entry of a PROGMEM task table. Tasks are listed highest priority first*/
+struct taskEntry_t
+{
+	taskFunc_t run;
+	uint16_t budget;			/*longest a run should take, in Timer0 ticks*/
+};
+
+/*Run statistics of one task, since they were last cleared*/
+struct taskStats_t
+{
+	uint32_t runs;				/*times the task did some work*/
+	uint16_t overruns;			/*times it took longer than its budget, saturates*/
+	uint16_t worst;				/*longest it has taken, in Timer0 ticks*/
+};
+
+/*************************************************************************
+Function: schedRun()
+Purpose:  one pass of the scheduler. The tasks are called in priority order until
+		  one of them does some work, so a task never runs while one above it
+		  has work waiting, and the wait for the highest priority task is at most
+		  the longest run of any single task below it. Every call is timed
+		  against the task's budget.
+Arguments: table, entries, the task table in flash and its length, no more than
+		   SCHED_TASKS_MAX
+Returns:  TRUE if a task did some work, FALSE if none of them had anything to do
+**************************************************************************/
+extern uint8_t schedRun(const struct taskEntry_t *table, uint8_t entries);
+
+/*Read the statistics of the task at index in the table, and clear them for every task*/
+extern void schedGetStats(uint8_t index, struct taskStats_t *stats);
+extern void schedClearStats(void);
+
+
+#endif
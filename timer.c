@@ -1,316 +1,411 @@
-/*! \file timer.c \brief System Timer function library. */
-//*****************************************************************************
-//
-// File Name	: 'timer.c'
-// Title		: System Timer function library
-// Author		: Pascal Stang - Copyright (C) 2000-2002
-// Created		: 11/22/2000
-// Revised		: 07/09/2003
-// Version		: 1.1
-// Target MCU	: Atmel AVR Series
-// Editor Tabs	: 4
-//
-// This code is distributed under the GNU Public License
-//		which can be found at http://www.gnu.org/licenses/gpl.txt
-//
-//*****************************************************************************
-
-#include <avr/io.h>
-#include <avr/interrupt.h>
-#include <avr/pgmspace.h>
-#include <avr/sleep.h>
-
-
-#include "global.h"
-#include "timer.h"
-
-
-
-//#include "rprintf.h"
-
-// Program ROM constants
-// the prescale division values stored in order of timer control register index
-// STOP, CLK, CLK/8, CLK/64, CLK/256, CLK/1024
-unsigned short __attribute__ ((progmem)) TimerPrescaleFactor[] = {0,1,8,64,256,1024};
-// the prescale division values stored in order of timer control register index
-// STOP, CLK, CLK/8, CLK/32, CLK/64, CLK/128, CLK/256, CLK/1024
-unsigned short __attribute__ ((progmem)) TimerRTCPrescaleFactor[] = {0,1,8,32,64,128,256,1024};
-
-// Global variables
-// time registers
-volatile unsigned long TimerPauseReg;
-volatile unsigned long Timer0Reg0;
-volatile unsigned long Timer2Reg0;
-
-typedef void (*voidFuncPtr)(void);
-volatile static voidFuncPtr TimerIntFunc[TIMER_NUM_INTERRUPTS];
-
-// delay for a minimum of <us> microseconds 
-// the time resolution is dependent on the time the loop takes 
-// e.g. with 4Mhz and 5 cycles per loop, the resolution is 1.25 us 
-#if 0
-void delay_us(unsigned short time_us) 
-{
-	unsigned short delay_loops;
-	register unsigned short i;
-
-	delay_loops = (time_us+3)/5*CYCLES_PER_US; // +3 for rounding up (dirty) 
-
-	// one loop takes 5 cpu cycles 
-	for (i=0; i < delay_loops; i++) {};
-}
-
-
-void delay_ms(unsigned char time_ms)
-{
-	unsigned short delay_count = F_CPU / 4000;
-
-	unsigned short cnt;
-	asm volatile ("\n"
-                  "L_dl1%=:\n\t"
-                  "mov %A0, %A2\n\t"
-                  "mov %B0, %B2\n"
-                  "L_dl2%=:\n\t"
-                  "sbiw %A0, 1\n\t"
-                  "brne L_dl2%=\n\t"
-                  "dec %1\n\t" "brne L_dl1%=\n\t":"=&w" (cnt)
-                  :"r"(time_ms), "r"((unsigned short) (delay_count))
-	);
-}
-
-#endif
-
-
-#if 1
-void timer0SetPrescaler(u08 prescale)
-{
-	// set prescaler on timer 0
-	outb(TCCR0, (inb(TCCR0) & ~TIMER_PRESCALE_MASK) | prescale);
-}
-
-
-void timerInit(void)
-{
-	u08 intNum;
-	// detach all user functions from interrupts
-	for(intNum=0; intNum<TIMER_NUM_INTERRUPTS; intNum++)
-		timerDetach(intNum);
-
-	// initialize all timers
-	timer0Init();
-	timer1Init();
-	
-	// enable interrupts
-	sei();
-}
-
-void timer0Init()
-{
-	// initialize timer 0
-	timer0SetPrescaler( TIMER0PRESCALE );	// set prescaler
-	outb(TCNT0, 0);							// reset TCNT0
-	sbi(TIMSK0, TOIE0);						// enable TCNT0 overflow interrupt
-
-	timer0ClearOverflowCount();				// initialize time registers
-}
-
-
-
-u16 timer0GetPrescaler(void)
-{
-	// get the current prescaler setting
-	return (pgm_read_word(TimerPrescaleFactor+(inb(TCCR0) & TIMER_PRESCALE_MASK)));
-}
-#endif
-
-void timer1Init(void)
-{
-	// initialize timer 1
-	timer1SetPrescaler( TIMER1PRESCALE );	// set prescaler
-	outb(TCNT1H, 0);						// reset TCNT1
-	outb(TCNT1L, 0);
-	sbi(TIMSK1, TOIE1);						// enable TCNT1 overflow
-}
-
-
-void timer1SetPrescaler(u08 prescale)
-{
-	// set prescaler on timer 1
-	outb(TCCR1B, (inb(TCCR1B) & ~TIMER_PRESCALE_MASK) | prescale);
-}
-
-
-u16 timer1GetPrescaler(void)
-{
-	// get the current prescaler setting
-	return (pgm_read_word(TimerPrescaleFactor+(inb(TCCR1B) & TIMER_PRESCALE_MASK)));
-}
-
-
-#if 1
-void timerAttach(u08 interruptNum, void (*userFunc)(void) )
-{
-	// make sure the interrupt number is within bounds
-	if(interruptNum < TIMER_NUM_INTERRUPTS)
-	{
-		// set the interrupt function to run
-		// the supplied user's function
-		TimerIntFunc[interruptNum] = userFunc;
-	}
-}
-
-
-void timerDetach(u08 interruptNum)
-{
-	// make sure the interrupt number is within bounds
-	if(interruptNum < TIMER_NUM_INTERRUPTS)
-	{
-		// set the interrupt function to run nothing
-		TimerIntFunc[interruptNum] = 0;
-	}
-}
-
-#endif
-
-u32 timerMsToTics(u16 ms)
-{
-	// calculate the prescaler division rate
-	u16 prescaleDiv = 1<<(pgm_read_byte(TimerPrescaleFactor+inb(TCCR0)));
-	// calculate the number of timer tics in x milliseconds
-	return (ms*(F_CPU/(prescaleDiv*256)))/1000;
-}
-
-u16 timerTicsToMs(u32 tics)
-{
-	// calculate the prescaler division rate
-	//u16 prescaleDiv = 1<<(pgm_read_byte(TimerPrescaleFactor+inb(TCCR0)));
-	u16 prescaleDiv = 1<<(pgm_read_byte(TimerPrescaleFactor+inb(TCCR1B)));
-	// calculate the number of milliseconds in x timer tics
-	return (tics*1000*(prescaleDiv*256))/F_CPU;
-}
-
-
-#if 0
-void timerPause(unsigned short pause_ms)
-{
-	// pauses for exactly <pause_ms> number of milliseconds
-	u08 timerThres;
-	u32 ticRateHz;
-	u32 pause;
-
-	// capture current pause timer value
-	timerThres = inb(TCNT0);
-	// reset pause timer overflow count
-	TimerPauseReg = 0;
-	// calculate delay for [pause_ms] milliseconds
-	// prescaler division = 1<<(pgm_read_byte(TimerPrescaleFactor+inb(TCCR0)))
-	ticRateHz = F_CPU/timer0GetPrescaler();
-	// precision management
-	// prevent overflow and precision underflow
-	//	-could add more conditions to improve accuracy
-	if( ((ticRateHz < 429497) && (pause_ms <= 10000)) )
-		pause = (pause_ms*ticRateHz)/1000;
-	else
-		pause = pause_ms*(ticRateHz/1000);
-
-	// loop until time expires
-	while( ((TimerPauseReg<<8) | inb(TCNT0)) < (pause+timerThres) )
-	{
-		if( TimerPauseReg < (pause>>8));
-		{
-			// save power by idling the processor
-			set_sleep_mode(SLEEP_MODE_IDLE);
-			sleep_mode();
-		}
-	}
-
-	/* old inaccurate code, for reference
-	
-	// calculate delay for [pause_ms] milliseconds
-	u16 prescaleDiv = 1<<(pgm_read_byte(TimerPrescaleFactor+inb(TCCR0)));
-	u32 pause = (pause_ms*(F_CPU/(prescaleDiv*256)))/1000;
-	
-	TimerPauseReg = 0;
-	while(TimerPauseReg < pause);
-
-	*/
-}
-
-#endif
-
-void timer0ClearOverflowCount(void)
-{
-	// clear the timer overflow counter registers
-	Timer0Reg0 = 0;	// initialize time registers
-}
-
-long timer0GetOverflowCount(void)
-{
-	// return the current timer overflow count
-	// (this is since the last timer0ClearOverflowCount() command was called)
-	return Timer0Reg0;
-}
-
-
-
-//! Interrupt handler for tcnt0 overflow interrupt
-ISR(TIMER0_OVF_vect)
-{
-	Timer0Reg0++;			// increment low-order counter
-
-	// increment pause counter
-	TimerPauseReg++;
-
-	// if a user function is defined, execute it too
-	if(TimerIntFunc[TIMER0OVERFLOW_INT])
-		TimerIntFunc[TIMER0OVERFLOW_INT]();
-}
-
-
-
-//! Interrupt handler for tcnt1 overflow interrupt
-ISR(TIMER1_OVF_vect)
-{
-	// if a user function is defined, execute it
-	if(TimerIntFunc[TIMER1OVERFLOW_INT])
-		TimerIntFunc[TIMER1OVERFLOW_INT]();
-}
-
-
-#if 0
-#ifdef OCR0
-// include support for Output Compare 0 for new AVR processors that support it
-//! Interrupt handler for OutputCompare0 match (OC0) interrupt
-ISR(TIMER0_COMP_vect)
-{
-	// if a user function is defined, execute it
-	if(TimerIntFunc[TIMER0OUTCOMPARE_INT])
-		TimerIntFunc[TIMER0OUTCOMPARE_INT]();
-}
-#endif
-
-//! Interrupt handler for CutputCompare1A match (OC1A) interrupt
-ISR(TIMER1_COMPA_vect)
-{
-	// if a user function is defined, execute it
-	if(TimerIntFunc[TIMER1OUTCOMPAREA_INT])
-		TimerIntFunc[TIMER1OUTCOMPAREA_INT]();
-}
-
-//! Interrupt handler for OutputCompare1B match (OC1B) interrupt
-ISR(TIMER1_COMPB_vect)
-{
-	// if a user function is defined, execute it
-	if(TimerIntFunc[TIMER1OUTCOMPAREB_INT])
-		TimerIntFunc[TIMER1OUTCOMPAREB_INT]();
-}
-
-//! Interrupt handler for InputCapture1 (IC1) interrupt
-ISR(TIMER1_CAPT_vect)
-{
-	// if a user function is defined, execute it
-	if(TimerIntFunc[TIMER1INPUTCAPTURE_INT])
-		TimerIntFunc[TIMER1INPUTCAPTURE_INT]();
-}
-
-#endif
+/*! \file timer.c \brief System Timer function library. */
+//*****************************************************************************
+//
+// File Name	: 'timer.c'
+// Title		: System Timer function library
+// Author		: Pascal Stang - Copyright (C) 2000-2002
+// Created		: 11/22/2000
+// Revised		: 07/09/2003
+// Version		: 1.1
+// Target MCU	: Atmel AVR Series
+// Editor Tabs	: 4
+//
+// This code is distributed under the GNU Public License
+//		which can be found at http://www.gnu.org/licenses/gpl.txt
+//
+//*****************************************************************************
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <avr/sleep.h>
+
+
+#include "global.h"
+#include "timer.h"
+
+
+
+//#include "rprintf.h"
+
+// Program ROM constants
+// the prescale division values stored in order of timer control register index
+// STOP, CLK, CLK/8, CLK/64, CLK/256, CLK/1024
+unsigned short __attribute__ ((progmem)) TimerPrescaleFactor[] = {0,1,8,64,256,1024};
+// the prescale division values stored in order of timer control register index
+// STOP, CLK, CLK/8, CLK/32, CLK/64, CLK/128, CLK/256, CLK/1024
+unsigned short __attribute__ ((progmem)) TimerRTCPrescaleFactor[] = {0,1,8,32,64,128,256,1024};
+
+// Global variables
+// time registers
+volatile unsigned long TimerPauseReg;
+volatile unsigned long Timer0Reg0;
+volatile unsigned long Timer1Reg0;
+volatile unsigned long Timer2Reg0;
+
+#if !TIMER_STATIC_DISPATCH
+typedef void (*voidFuncPtr)(void);
+volatile static voidFuncPtr TimerIntFunc[TIMER_NUM_INTERRUPTS];
+#endif
+
+// delay for a minimum of <us> microseconds 
+// the time resolution is dependent on the time the loop takes 
+// e.g. with 4Mhz and 5 cycles per loop, the resolution is 1.25 us 
+#if 0
+void delay_us(unsigned short time_us) 
+{
+	unsigned short delay_loops;
+	register unsigned short i;
+
+	delay_loops = (time_us+3)/5*CYCLES_PER_US; // +3 for rounding up (dirty) 
+
+	// one loop takes 5 cpu cycles 
+	for (i=0; i < delay_loops; i++) {};
+}
+
+
+void delay_ms(unsigned char time_ms)
+{
+	unsigned short delay_count = F_CPU / 4000;
+
+	unsigned short cnt;
+	asm volatile ("\n"
+                  "L_dl1%=:\n\t"
+                  "mov %A0, %A2\n\t"
+                  "mov %B0, %B2\n"
+                  "L_dl2%=:\n\t"
+                  "sbiw %A0, 1\n\t"
+                  "brne L_dl2%=\n\t"
+                  "dec %1\n\t" "brne L_dl1%=\n\t":"=&w" (cnt)
+                  :"r"(time_ms), "r"((unsigned short) (delay_count))
+	);
+}
+
+#endif
+
+
+#if 1
+void timer0SetPrescaler(u08 prescale)
+{
+	// set prescaler on timer 0
+	outb(TCCR0, (inb(TCCR0) & ~TIMER_PRESCALE_MASK) | prescale);
+}
+
+
+void timerInit(void)
+{
+#if !TIMER_STATIC_DISPATCH
+	u08 intNum;
+	// detach all user functions from interrupts
+	for(intNum=0; intNum<TIMER_NUM_INTERRUPTS; intNum++)
+		timerDetach(intNum);
+#endif
+
+	// initialize all timers
+	timer0Init();
+	timer1Init();
+	
+	// enable interrupts
+	sei();
+}
+
+void timer0Init()
+{
+	// initialize timer 0
+	timer0SetPrescaler( TIMER0PRESCALE );	// set prescaler
+	outb(TCNT0, 0);							// reset TCNT0
+	sbi(TIMSK0, TOIE0);						// enable TCNT0 overflow interrupt
+
+	timer0ClearOverflowCount();				// initialize time registers
+}
+
+
+
+u16 timer0GetPrescaler(void)
+{
+	// get the current prescaler setting
+	return (pgm_read_word(TimerPrescaleFactor+(inb(TCCR0) & TIMER_PRESCALE_MASK)));
+}
+#endif
+
+void timer1Init(void)
+{
+	// initialize timer 1
+	timer1SetPrescaler( TIMER1PRESCALE );	// set prescaler
+	outb(TCNT1H, 0);						// reset TCNT1
+	outb(TCNT1L, 0);
+	sbi(TIMSK1, TOIE1);						// enable TCNT1 overflow
+}
+
+
+void timer1SetPrescaler(u08 prescale)
+{
+	// set prescaler on timer 1
+	outb(TCCR1B, (inb(TCCR1B) & ~TIMER_PRESCALE_MASK) | prescale);
+}
+
+
+u16 timer1GetPrescaler(void)
+{
+	// get the current prescaler setting
+	return (pgm_read_word(TimerPrescaleFactor+(inb(TCCR1B) & TIMER_PRESCALE_MASK)));
+}
+
+
+#ifdef TCNT2	// support timer2 only if it exists
+void timer2SetPrescaler(u08 prescale)
+{
+	// set prescaler on timer 2, which has the RTC style prescaler
+	outb(TCCR2B, (inb(TCCR2B) & ~TIMERRTC_PRESCALE_MASK) | prescale);
+}
+
+
+u16 timer2GetPrescaler(void)
+{
+	// get the current prescaler setting
+	return (pgm_read_word(TimerRTCPrescaleFactor+(inb(TCCR2B) & TIMERRTC_PRESCALE_MASK)));
+}
+#endif
+
+
+#if !TIMER_STATIC_DISPATCH
+void timerAttach(u08 interruptNum, void (*userFunc)(void) )
+{
+	// make sure the interrupt number is within bounds
+	if(interruptNum < TIMER_NUM_INTERRUPTS)
+	{
+		// set the interrupt function to run
+		// the supplied user's function
+		TimerIntFunc[interruptNum] = userFunc;
+	}
+}
+
+
+void timerDetach(u08 interruptNum)
+{
+	// make sure the interrupt number is within bounds
+	if(interruptNum < TIMER_NUM_INTERRUPTS)
+	{
+		// set the interrupt function to run nothing
+		TimerIntFunc[interruptNum] = 0;
+	}
+}
+
+#endif
+
+u32 timerMsToTics(u16 ms)
+{
+	// calculate the prescaler division rate
+	u16 prescaleDiv = 1<<(pgm_read_byte(TimerPrescaleFactor+inb(TCCR0)));
+	// calculate the number of timer tics in x milliseconds
+	return (ms*(F_CPU/(prescaleDiv*256)))/1000;
+}
+
+u16 timerTicsToMs(u32 tics)
+{
+	// calculate the prescaler division rate
+	//u16 prescaleDiv = 1<<(pgm_read_byte(TimerPrescaleFactor+inb(TCCR0)));
+	u16 prescaleDiv = 1<<(pgm_read_byte(TimerPrescaleFactor+inb(TCCR1B)));
+	// calculate the number of milliseconds in x timer tics
+	return (tics*1000*(prescaleDiv*256))/F_CPU;
+}
+
+
+#if 0
+void timerPause(unsigned short pause_ms)
+{
+	// pauses for exactly <pause_ms> number of milliseconds
+	u08 timerThres;
+	u32 ticRateHz;
+	u32 pause;
+
+	// capture current pause timer value
+	timerThres = inb(TCNT0);
+	// reset pause timer overflow count
+	TimerPauseReg = 0;
+	// calculate delay for [pause_ms] milliseconds
+	// prescaler division = 1<<(pgm_read_byte(TimerPrescaleFactor+inb(TCCR0)))
+	ticRateHz = F_CPU/timer0GetPrescaler();
+	// precision management
+	// prevent overflow and precision underflow
+	//	-could add more conditions to improve accuracy
+	if( ((ticRateHz < 429497) && (pause_ms <= 10000)) )
+		pause = (pause_ms*ticRateHz)/1000;
+	else
+		pause = pause_ms*(ticRateHz/1000);
+
+	// loop until time expires
+	while( ((TimerPauseReg<<8) | inb(TCNT0)) < (pause+timerThres) )
+	{
+		if( TimerPauseReg < (pause>>8));
+		{
+			// save power by idling the processor
+			set_sleep_mode(SLEEP_MODE_IDLE);
+			sleep_mode();
+		}
+	}
+
+	/* old inaccurate code, for reference
+	
+	// calculate delay for [pause_ms] milliseconds
+	u16 prescaleDiv = 1<<(pgm_read_byte(TimerPrescaleFactor+inb(TCCR0)));
+	u32 pause = (pause_ms*(F_CPU/(prescaleDiv*256)))/1000;
+	
+	TimerPauseReg = 0;
+	while(TimerPauseReg < pause);
+
+	*/
+}
+
+#endif
+
+void timer0ClearOverflowCount(void)
+{
+	// clear the timer overflow counter registers
+	Timer0Reg0 = 0;	// initialize time registers
+}
+
+long timer0GetOverflowCount(void)
+{
+	// return the current timer overflow count
+	// (this is since the last timer0ClearOverflowCount() command was called)
+	return Timer0Reg0;
+}
+
+void timer1ClearOverflowCount(void)
+{
+	// clear the timer overflow counter registers
+	Timer1Reg0 = 0;	// initialize time registers
+}
+
+long timer1GetOverflowCount(void)
+{
+	// return the current timer overflow count
+	// (this is since the last timer1ClearOverflowCount() command was called)
+	return Timer1Reg0;
+}
+
+u32 timer1GetTimestamp(void)
+{
+	u08 sreg;
+	u16 count;
+	u32 overflows;
+
+	// read TCNT1 and the overflow count as one consistent value
+	sreg = SREG;
+	cli();
+	count = inw(TCNT1);
+	overflows = Timer1Reg0;
+	// an overflow that hasn't been serviced yet belongs to this count
+	// only if TCNT1 has already wrapped round to a small value
+	if( (inb(TIFR1) & BV(TOV1)) && (count < 0x8000) )
+		overflows++;
+	SREG = sreg;
+
+	return (overflows<<16) | count;
+}
+
+u16 timer0GetTimestamp(void)
+{
+	u08 sreg;
+	u08 count;
+	u16 overflows;
+
+	// same as timer1GetTimestamp(), with only the low byte of the overflow count needed
+	sreg = SREG;
+	cli();
+	count = inb(TCNT0);
+	overflows = Timer0Reg0;
+	if( (inb(TIFR0) & BV(TOV0)) && (count < 0x80) )
+		overflows++;
+	SREG = sreg;
+
+	return (overflows<<8) | count;
+}
+
+
+
+//! Interrupt handler for tcnt0 overflow interrupt
+ISR(TIMER0_OVF_vect)
+{
+	Timer0Reg0++;			// increment low-order counter
+	WAKE_MARK(WAKE_TIMER);
+
+	// increment pause counter
+	TimerPauseReg++;
+
+#if !TIMER_STATIC_DISPATCH
+	// if a user function is defined, execute it too
+	if(TimerIntFunc[TIMER0OVERFLOW_INT])
+		TimerIntFunc[TIMER0OVERFLOW_INT]();
+#endif
+}
+
+
+
+//! Interrupt handler for tcnt1 overflow interrupt
+ISR(TIMER1_OVF_vect)
+{
+	Timer1Reg0++;			// increment overflow counter
+	WAKE_MARK(WAKE_TIMER);
+
+#if !TIMER_STATIC_DISPATCH
+	// if a user function is defined, execute it
+	if(TimerIntFunc[TIMER1OVERFLOW_INT])
+		TimerIntFunc[TIMER1OVERFLOW_INT]();
+#endif
+}
+
+// with TIMER_STATIC_DISPATCH these two are defined by uartsw_Tx.c and pulseCapture.c
+#if !TIMER_STATIC_DISPATCH
+#ifdef TCNT2	// support timer2 only if it exists
+//! Interrupt handler for OutputCompare2A match (OC2A) interrupt, the software UART bit timing
+ISR(TIMER2_COMPA_vect)
+{
+	WAKE_MARK(WAKE_TIMER);
+
+	// if a user function is defined, execute it
+	if(TimerIntFunc[TIMER2OUTCOMPARE_INT])
+		TimerIntFunc[TIMER2OUTCOMPARE_INT]();
+}
+#endif
+
+//! Interrupt handler for InputCapture1 (IC1) interrupt
+ISR(TIMER1_CAPT_vect)
+{
+	// if a user function is defined, execute it
+	if(TimerIntFunc[TIMER1INPUTCAPTURE_INT])
+		TimerIntFunc[TIMER1INPUTCAPTURE_INT]();
+}
+#endif
+
+
+#if 0
+#ifdef OCR0
+// include support for Output Compare 0 for new AVR processors that support it
+//! Interrupt handler for OutputCompare0 match (OC0) interrupt
+ISR(TIMER0_COMP_vect)
+{
+	// if a user function is defined, execute it
+	if(TimerIntFunc[TIMER0OUTCOMPARE_INT])
+		TimerIntFunc[TIMER0OUTCOMPARE_INT]();
+}
+#endif
+
+//! Interrupt handler for CutputCompare1A match (OC1A) interrupt
+ISR(TIMER1_COMPA_vect)
+{
+	// if a user function is defined, execute it
+	if(TimerIntFunc[TIMER1OUTCOMPAREA_INT])
+		TimerIntFunc[TIMER1OUTCOMPAREA_INT]();
+}
+
+//! Interrupt handler for OutputCompare1B match (OC1B) interrupt
+ISR(TIMER1_COMPB_vect)
+{
+	// if a user function is defined, execute it
+	if(TimerIntFunc[TIMER1OUTCOMPAREB_INT])
+		TimerIntFunc[TIMER1OUTCOMPAREB_INT]();
+}
+
+#endif
@@ -1,334 +1,577 @@
-/*************************************************************************
-Title:    Interrupt UART library with receive/transmit circular buffers
-Author:   Peter Fleury <pfleury@gmx.ch>   http://jump.to/fleury
-File:     $Id: uart.c,v 1.6.2.1 2007/07/01 11:14:38 peter Exp $
-Software: AVR-GCC 4.1, AVR Libc 1.4.6 or higher
-Hardware: any AVR with built-in UART, 
-License:  GNU General Public License 
-          
-DESCRIPTION:
-    An interrupt is generated when the UART has finished transmitting or
-    receiving a byte. The interrupt handling routines use circular buffers
-    for buffering received and transmitted data.
-    
-    The UART_RX_BUFFER_SIZE and UART_TX_BUFFER_SIZE variables define
-    the buffer size in bytes. Note that these variables must be a 
-    power of 2.
-    
-USAGE:
-    Refere to the header file uart.h for a description of the routines. 
-    See also example test_uart.c.
-
-NOTES:
-    Based on Atmel Application Note AVR306
-                    
-LICENSE:
-    Copyright (C) 2006 Peter Fleury
-
-    This program is free software; you can redistribute it and/or modify
-    it under the terms of the GNU General Public License as published by
-    the Free Software Foundation; either version 2 of the License, or
-    any later version.
-
-    This program is distributed in the hope that it will be useful,
-    but WITHOUT ANY WARRANTY; without even the implied warranty of
-    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
-    GNU General Public License for more details.
-                        
-*************************************************************************/
-#include <avr/io.h>
-#include <avr/interrupt.h>
-#include <avr/pgmspace.h>
-#include "uart.h"
-
-
-#define SER_COMMAND_INTERPRET 1
-
-
-
-
-/*
- *  module global variables
- */
-static volatile unsigned char UART_TxBuf[UART_TX_BUFFER_SIZE];
-static volatile unsigned char UART_RxBuf[UART_RX_BUFFER_SIZE];
-static volatile unsigned char UART_TxHead;
-static volatile unsigned char UART_TxTail;
-static volatile unsigned char UART_RxHead;
-static volatile unsigned char UART_RxTail;
-static volatile unsigned char UART_LastRxError;
-
-/*Have to make this flag visible to the main() function*/
-volatile unsigned char serCmndReady;
-
-
-
-#if defined( SER_COMMAND_INTERPRET )
-
-
-
-ISR(UART0_RECEIVE_INTERRUPT)
-{
-    unsigned char tmphead;
-    unsigned char data;
-    unsigned char usr;
-    unsigned char lastRxError;
- 
- 
-    /* read UART status register and UART data register */ 
-    usr  = UART0_STATUS;
-    data = UART0_DATA;	//get a character
-
-	/*TODO:DEBUG:RCC
-	**While debugging serial receive routines echo all received characters
-	*/
-	//UART0_DATA = data;
-	/*END TODO*/
-    
-    /* */
-
-
-    lastRxError = (usr & (_BV(FE0)|_BV(DOR0)) );
-
-        
-    /* calculate buffer index */ 
-    tmphead = ( UART_RxHead + 1) & UART_RX_BUFFER_MASK;
-    
-	/*If we receive more characters than the size of the buffer before we receive an end of
-	string \r terminator then we reset the buffer and effectively discard all current contents*/
-    if ( tmphead == UART_RxTail )
-	{
-        /* error: receive buffer overflow */
-        lastRxError = UART_BUFFER_OVERFLOW >> 8;
-		/*Discard buffer content and start again*/
-		UART_RxTail = 0;
-		UART_RxHead = 0;
-		tmphead = 0;
-
-    }
-	//else
-	//{
-        /* store new index */
-        UART_RxHead = tmphead;
-
-		/*TODO:DEBUG:RCC
-		**While debugging serial receive routines echo all received characters
-		
-		UART0_DATA = data;
-		*/
-
-		if(data != '\r')
-		{
-	        /* store received data in buffer */
-	        UART_RxBuf[tmphead] = data;
-		}
-		else
-		{
-			UART_RxBuf[tmphead] = 0x00;
-			serCmndReady = 1;
-			
-			
-		}
-
-
-		
-    //}
-    UART_LastRxError = lastRxError;   
-}
-#else
-
-
-ISR(UART0_RECEIVE_INTERRUPT)
-/*************************************************************************
-Function: UART Receive Complete interrupt
-Purpose:  called when the UART has received a character
-
-When interrupt-driven data reception is used, the receive complete routine 
-must read the received data from UDR in order to clear the RXC Flag, 
-otherwise a new interrupt will occur once the interrupt routine terminates. 
-**************************************************************************/
-{
-    unsigned char tmphead;
-    unsigned char data;
-    unsigned char usr;
-    unsigned char lastRxError;
- 
- 
-    /* read UART status register and UART data register */ 
-    usr  = UART0_STATUS;
-    data = UART0_DATA;
-    
-    /* */
-
-
-    lastRxError = (usr & (_BV(FE0)|_BV(DOR0)) );
-
-        
-    /* calculate buffer index */ 
-    tmphead = ( UART_RxHead + 1) & UART_RX_BUFFER_MASK;
-    
-    if ( tmphead == UART_RxTail )
-	{
-        /* error: receive buffer overflow */
-        lastRxError = UART_BUFFER_OVERFLOW >> 8;
-    }
-	else
-	{
-        /* store new index */
-        UART_RxHead = tmphead;
-        /* store received data in buffer */
-        UART_RxBuf[tmphead] = data;
-    }
-    UART_LastRxError = lastRxError;   
-}
-
-#endif 
-
-
-ISR(UART0_TRANSMIT_INTERRUPT)
-/*************************************************************************
-Function: UART Data Register Empty interrupt
-Purpose:  called when the UART is ready to transmit the next byte
-**************************************************************************/
-{
-    unsigned char tmptail;
-
-    
-    if ( UART_TxHead != UART_TxTail) {
-        /* calculate and store new buffer index */
-        tmptail = (UART_TxTail + 1) & UART_TX_BUFFER_MASK;
-        UART_TxTail = tmptail;
-        /* get one byte from buffer and write it to UART */
-        UART0_DATA = UART_TxBuf[tmptail];  /* start transmission */
-    }else{
-        /* tx buffer empty, disable UDRE interrupt */
-        UART0_CONTROL &= ~_BV(UART0_UDRIE);
-    }
-}
-
-
-
-/*************************************************************************
-Function: uart_init()
-Purpose:  initialize UART and set baudrate
-Input:    baudrate using macro UART_BAUD_SELECT()
-Returns:  none
-**************************************************************************/
-void uart_init(unsigned int baudrate)
-{
-    uint16_t	ubbr;
-	
-	UART_TxHead = 0;
-    UART_TxTail = 0;
-    UART_RxHead = 0;
-    UART_RxTail = 0;
-    
-	ubbr = (uint16_t) ((F_CPU * 10)/(baudrate * 16));
-	if ((ubbr % 10) >= 5) ubbr += 10;	// rounding
-	ubbr = (ubbr/10) - 1;
-
-	/*Set baud rate*/
-	UBRR0H = (ubbr >> 8);	// set baud rate
-    UBRR0L = ubbr;
-
-	/*Enable receiver and transmitter*/
-    UCSR0B = (1<<RXCIE)|(1<<RXEN0)|(1<<TXEN0); 		 // enable Rx & Tx and the receive complete interrupt
-
-	/*Set frame format: 8data, No parity, 1 stop bit */
-    UCSR0C=  (1<<UCSZ01)|(1<<UCSZ00);  	        // config USART; 8N1
-
-
-}/* uart_init */
-
-
-/*************************************************************************
-Function: uart_getc()
-Purpose:  return byte from ringbuffer  
-Returns:  lower byte:  received byte from ringbuffer
-          higher byte: last receive error
-**************************************************************************/
-unsigned int uart_getc(void)
-{    
-    unsigned char tmptail;
-    unsigned char data;
-
-
-    if ( UART_RxHead == UART_RxTail ) {
-        return UART_NO_DATA;   /* no data available */
-    }
-    
-    /* calculate /store buffer index */
-    tmptail = (UART_RxTail + 1) & UART_RX_BUFFER_MASK;
-    UART_RxTail = tmptail; 
-    
-    /* get data from receive buffer */
-    data = UART_RxBuf[tmptail];
-    
-	/*TODO:DEBUG:RCC
-	if(UART_LastRxError == (UART_BUFFER_OVERFLOW>>8))
-	{
-		uart_ResetRxBuffer();
-	}*/
-
-    return (UART_LastRxError << 8) + data;
-
-}/* uart_getc */
-
-
-/*************************************************************************
-Function: uart_putc()
-Purpose:  write byte to ringbuffer for transmitting via UART
-Input:    byte to be transmitted
-Returns:  none          
-**************************************************************************/
-
-void uart_putc(unsigned char data)
-{
-    unsigned char tmphead;
-
-    
-    tmphead  = (UART_TxHead + 1) & UART_TX_BUFFER_MASK;
-    
-    while ( tmphead == UART_TxTail ){
-        ;/* wait for free space in buffer */
-    }
-    
-    UART_TxBuf[tmphead] = data;
-    UART_TxHead = tmphead;
-
-    /* enable UDRE interrupt */
-    UART0_CONTROL    |= _BV(UART0_UDRIE);
-
-}/* uart_putc */
-
-
-/*************************************************************************
-Function: uart_puts()
-Purpose:  transmit string to UART
-Input:    string to be transmitted
-Returns:  none          
-**************************************************************************/
-void uart_puts(const char *s )
-{
-    while (*s) 
-      uart_putc(*s++);
-
-}/* uart_puts */
-
-
-/*************************************************************************
-Function: uart_puts_p()
-Purpose:  transmit string from program memory to UART
-Input:    program memory string to be transmitted
-Returns:  none
-**************************************************************************/
-void uart_puts_p(const char *progmem_s )
-{
-    register char c;
-    
-    while ( (c = pgm_read_byte(progmem_s++)) ) 
-      uart_putc(c);
-
-}/* uart_puts_p */
-
-
+/*************************************************************************
+Title:    Interrupt UART library with receive/transmit circular buffers
+Author:   Peter Fleury <pfleury@gmx.ch>   http://jump.to/fleury
+File:     $Id: uart.c,v 1.6.2.1 2007/07/01 11:14:38 peter Exp $
+Software: AVR-GCC 4.1, AVR Libc 1.4.6 or higher
+Hardware: any AVR with built-in UART, 
+License:  GNU General Public License 
+          
+DESCRIPTION:
+    An interrupt is generated when the UART has finished transmitting or
+    receiving a byte. The interrupt handling routines use circular buffers
+    for buffering received and transmitted data.
+    
+    The UART_RX_BUFFER_SIZE and UART_TX_BUFFER_SIZE variables define
+    the buffer size in bytes. Note that these variables must be a 
+    power of 2.
+    
+USAGE:
+    Refere to the header file uart.h for a description of the routines. 
+    See also example test_uart.c.
+
+NOTES:
+    Based on Atmel Application Note AVR306
+                    
+LICENSE:
+    Copyright (C) 2006 Peter Fleury
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+                        
+*************************************************************************/
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include "uart.h"
+#include "timer.h"
+#include "serialcommand_rcc.h"
+#include "profiler.h"
+
+
+
+
+/*
+ *  module global variables
+ */
+static volatile unsigned char UART_TxBuf[UART_TX_BUFFER_SIZE];
+static volatile unsigned char UART_TxHead;
+static volatile unsigned char UART_TxTail;
+#if !SER_COMMAND_INTERPRET
+static volatile unsigned char UART_RxBuf[UART_RX_BUFFER_SIZE];
+static volatile unsigned char UART_RxHead;
+static volatile unsigned char UART_RxTail;
+static volatile unsigned char UART_LastRxError;
+#endif
+
+/* transmit wait hook and statistics, only used outside the ISRs */
+static void (*UART_TxWaitHook)(void);
+static void (*UART_TxTap)(unsigned char data);
+static unsigned int UART_TxStalls;
+static unsigned int UART_TxDrops;
+
+/* set once the first byte has been loaded, until then TXC can't say anything */
+static volatile unsigned char UART_TxStarted;
+
+#if RS485_MULTIDROP
+/* writes are being thrown away, see uart_setTxMute() */
+static unsigned char UART_TxMute;
+
+/* set by UART0_TXC_INTERRUPT when it releases the bus, cleared when a byte is queued. The TXC
+   flag can't be used for this, the hardware clears it when the interrupt runs */
+static volatile unsigned char UART_TxDone;
+
+/* Timer0 timestamp of the last byte received, and RS485_TURNAROUND_BITS in Timer0 ticks at the
+   current rate */
+static volatile unsigned int UART_RxTime;
+static unsigned int UART_TurnaroundTicks;
+
+static void uart_busAcquire(void);
+
+/* take the bus before the first byte goes, the driver stays on until UART0_TXC_INTERRUPT */
+#define UART_TX_START()  uart_busAcquire()
+#else
+#define UART_TX_START()  (UART0_CONTROL |= _BV(UART0_UDRIE))
+#endif
+
+#if SER_COMMAND_INTERPRET
+
+
+
+/*************************************************************************
+Function: UART Receive Complete interrupt
+Purpose:  hand each received character straight to the command framing state
+		  machine, see sc_parseByte(). Commands come out of it fully parsed, so
+		  nothing goes through the receive ringbuffer.
+**************************************************************************/
+ISR(UART0_RECEIVE_INTERRUPT)
+{
+    unsigned char data;
+    unsigned char usr;
+    PROFILE_BEGIN(PROF_UART_RX_ISR);
+ 
+ 
+    /* read UART status register and UART data register */ 
+    usr  = UART0_STATUS;
+    data = UART0_DATA;	//get a character
+
+#if RS485_MULTIDROP
+    UART_RxTime = timer0GetTimestamp();
+#endif
+    WAKE_MARK(WAKE_SERIAL_RX);
+    sc_parseByte(data, usr & (_BV(FE0)|_BV(DOR0)));
+    PROFILE_END(PROF_UART_RX_ISR);
+}
+#else
+
+
+ISR(UART0_RECEIVE_INTERRUPT)
+/*************************************************************************
+Function: UART Receive Complete interrupt
+Purpose:  called when the UART has received a character
+
+When interrupt-driven data reception is used, the receive complete routine 
+must read the received data from UDR in order to clear the RXC Flag, 
+otherwise a new interrupt will occur once the interrupt routine terminates. 
+**************************************************************************/
+{
+    unsigned char tmphead;
+    unsigned char data;
+    unsigned char usr;
+    unsigned char lastRxError;
+    PROFILE_BEGIN(PROF_UART_RX_ISR);
+ 
+ 
+    /* read UART status register and UART data register */ 
+    usr  = UART0_STATUS;
+    data = UART0_DATA;
+    
+    /* */
+
+
+    lastRxError = (usr & (_BV(FE0)|_BV(DOR0)) );
+#if RS485_MULTIDROP
+    UART_RxTime = timer0GetTimestamp();
+#endif
+    WAKE_MARK(WAKE_SERIAL_RX);
+
+        
+    /* calculate buffer index */ 
+    tmphead = ( UART_RxHead + 1) & UART_RX_BUFFER_MASK;
+    
+    if ( tmphead == UART_RxTail )
+	{
+        /* error: receive buffer overflow */
+        lastRxError = UART_BUFFER_OVERFLOW >> 8;
+    }
+	else
+	{
+        /* store new index */
+        UART_RxHead = tmphead;
+        /* store received data in buffer */
+        UART_RxBuf[tmphead] = data;
+    }
+    UART_LastRxError = lastRxError;   
+    PROFILE_END(PROF_UART_RX_ISR);
+}
+
+#endif 
+
+
+ISR(UART0_TRANSMIT_INTERRUPT)
+/*************************************************************************
+Function: UART Data Register Empty interrupt
+Purpose:  called when the UART is ready to transmit the next byte
+**************************************************************************/
+{
+    unsigned char tmptail;
+    PROFILE_BEGIN(PROF_UART_UDRE_ISR);
+
+    WAKE_MARK(WAKE_SERIAL_TX);
+    
+    if ( UART_TxHead != UART_TxTail) {
+        /* calculate and store new buffer index */
+        tmptail = (UART_TxTail + 1) & UART_TX_BUFFER_MASK;
+        UART_TxTail = tmptail;
+        /* clear transmit complete, so it only gets set again once this byte has gone.
+           Writing 0 to the error flags and keeping U2X as it is */
+        UART0_STATUS = (UART0_STATUS & _BV(U2X0)) | _BV(TXC0);
+        UART_TxStarted = 1;
+        /* get one byte from buffer and write it to UART */
+        UART0_DATA = UART_TxBuf[tmptail];  /* start transmission */
+    }else{
+        /* tx buffer empty, disable UDRE interrupt */
+        UART0_CONTROL &= ~_BV(UART0_UDRIE);
+    }
+    PROFILE_END(PROF_UART_UDRE_ISR);
+}
+
+
+#if RS485_MULTIDROP
+ISR(UART0_TXC_INTERRUPT)
+/*************************************************************************
+Function: UART Transmit Complete interrupt
+Purpose:  release the bus once the last queued byte has completely gone. Runs
+          at the end of the stop bit, when the UDRE interrupt has nothing more
+          to load. Anything queued since then keeps the driver on, UDRE will
+          be along to send it.
+**************************************************************************/
+{
+    WAKE_MARK(WAKE_SERIAL_TX);
+    if ( UART_TxHead == UART_TxTail ){
+        RS485_DE_PORT &= ~_BV(RS485_DE_PIN);
+        UART_TxDone = 1;
+    }
+}
+
+
+/*************************************************************************
+Function: uart_busAcquire()
+Purpose:  raise the driver enable, if it isn't already, and start the UDRE
+          interrupt. Called with a byte already in the ringbuffer, so the TXC
+          interrupt can't drop the driver in the meantime. Waits until
+          RS485_TURNAROUND_BITS have passed since the last byte was received,
+          running the wait hook meanwhile. A receive over 1.14 sec ago can look
+          recent once the 16 bit timestamp has wrapped, which costs at most one
+          unnecessary turnaround wait
+**************************************************************************/
+static void uart_busAcquire(void)
+{
+    if ( !(RS485_DE_PORT & _BV(RS485_DE_PIN)) ){
+        while ( (unsigned int)(timer0GetTimestamp() - UART_RxTime) < UART_TurnaroundTicks ){
+            if ( UART_TxWaitHook ) UART_TxWaitHook();
+        }
+        RS485_DE_PORT |= _BV(RS485_DE_PIN);
+    }
+    UART_TxDone = 0;
+    UART0_CONTROL |= _BV(UART0_UDRIE);
+
+}/* uart_busAcquire */
+#endif
+
+
+
+/*************************************************************************
+Function: uart_setBaud()
+Purpose:  set the baudrate, in normal or double speed mode whichever is closer
+Input:    baudrate in bps
+Returns:  none
+**************************************************************************/
+void uart_setBaud(unsigned long baudrate)
+{
+    unsigned long ubrr16;
+    unsigned long ubrr8;
+    unsigned long error16;
+    unsigned long error8;
+
+    /* nearest UBRR for 16 and 8 samples per bit, then the error each leaves */
+    ubrr16 = (F_CPU + 8UL*baudrate)/(16UL*baudrate);
+    ubrr8  = (F_CPU + 4UL*baudrate)/(8UL*baudrate);
+    if ( ubrr16 == 0 ) ubrr16 = 1;
+    if ( ubrr8 == 0 ) ubrr8 = 1;
+
+    error16 = F_CPU/(16UL*ubrr16);
+    error16 = (error16 > baudrate) ? (error16 - baudrate) : (baudrate - error16);
+    error8  = F_CPU/(8UL*ubrr8);
+    error8  = (error8 > baudrate) ? (error8 - baudrate) : (baudrate - error8);
+
+    if ( error16 <= error8 ){
+        UART0_STATUS = 0;
+        ubrr16--;
+    }else{
+        UART0_STATUS = _BV(U2X0);
+        ubrr16 = ubrr8 - 1;
+    }
+
+	/*Set baud rate*/
+	UBRR0H = (unsigned char)(ubrr16 >> 8);	// set baud rate
+    UBRR0L = (unsigned char)ubrr16;
+
+#if RS485_MULTIDROP
+    /* rounded up, and one more for the tick the last byte was stamped in */
+    UART_TurnaroundTicks = ((RS485_TURNAROUND_BITS * (F_CPU/64UL)) + baudrate - 1)/baudrate + 1;
+#endif
+
+}/* uart_setBaud */
+
+
+/*************************************************************************
+Function: uart_txIdle()
+Purpose:  check whether transmission has completely finished
+Returns:  non zero if the ringbuffer is empty and the last byte has been shifted out
+**************************************************************************/
+unsigned char uart_txIdle(void)
+{
+#if RS485_MULTIDROP
+    return ( (UART_TxHead == UART_TxTail) && UART_TxDone );
+#else
+    return ( (UART_TxHead == UART_TxTail) && (!UART_TxStarted || (UART0_STATUS & _BV(TXC0))) );
+#endif
+
+}/* uart_txIdle */
+
+
+/*************************************************************************
+Function: uart_init()
+Purpose:  initialize UART and set baudrate
+Input:    baudrate in bps
+Returns:  none
+**************************************************************************/
+void uart_init(unsigned long baudrate)
+{
+	UART_TxHead = 0;
+    UART_TxTail = 0;
+#if !SER_COMMAND_INTERPRET
+    UART_RxHead = 0;
+    UART_RxTail = 0;
+#endif
+
+    UART_TxStarted = 0;
+
+	uart_setBaud(baudrate);
+
+#if RS485_MULTIDROP
+    UART_TxMute = 0;
+    UART_TxDone = 1;
+    UART_RxTime = 0;
+	/*Driver off, listening to the bus*/
+    RS485_DE_PORT &= ~_BV(RS485_DE_PIN);
+    RS485_DE_DDR |= _BV(RS485_DE_PIN);
+
+	/*Enable receiver and transmitter, and the transmit complete interrupt for the driver enable*/
+    UCSR0B = (1<<RXCIE)|(1<<TXCIE0)|(1<<RXEN0)|(1<<TXEN0);
+#else
+	/*Enable receiver and transmitter*/
+    UCSR0B = (1<<RXCIE)|(1<<RXEN0)|(1<<TXEN0); 		 // enable Rx & Tx and the receive complete interrupt
+#endif
+
+	/*Set frame format: 8data, No parity, 1 stop bit */
+    UCSR0C=  (1<<UCSZ01)|(1<<UCSZ00);  	        // config USART; 8N1
+
+
+}/* uart_init */
+
+
+#if !SER_COMMAND_INTERPRET
+/*************************************************************************
+Function: uart_getc()
+Purpose:  return byte from ringbuffer  
+Returns:  lower byte:  received byte from ringbuffer
+          higher byte: last receive error
+**************************************************************************/
+unsigned int uart_getc(void)
+{    
+    unsigned char tmptail;
+    unsigned char data;
+
+
+    if ( UART_RxHead == UART_RxTail ) {
+        return UART_NO_DATA;   /* no data available */
+    }
+    
+    /* calculate /store buffer index */
+    tmptail = (UART_RxTail + 1) & UART_RX_BUFFER_MASK;
+    UART_RxTail = tmptail; 
+    
+    /* get data from receive buffer */
+    data = UART_RxBuf[tmptail];
+    
+	/*TODO:DEBUG:RCC
+	if(UART_LastRxError == (UART_BUFFER_OVERFLOW>>8))
+	{
+		uart_ResetRxBuffer();
+	}*/
+
+    return (UART_LastRxError << 8) + data;
+
+}/* uart_getc */
+#endif
+
+
+/*************************************************************************
+Function: uart_putc()
+Purpose:  write byte to ringbuffer for transmitting via UART
+Input:    byte to be transmitted
+Returns:  none          
+**************************************************************************/
+
+void uart_putc(unsigned char data)
+{
+    unsigned char tmphead;
+    unsigned int loops;
+
+#if RS485_MULTIDROP
+    if ( UART_TxMute ) return;
+#endif
+
+    /* before the buffer full check, the tap sees what was meant to go even if it gets dropped */
+    if ( UART_TxTap ) UART_TxTap(data);
+    
+    tmphead  = (UART_TxHead + 1) & UART_TX_BUFFER_MASK;
+    
+    if ( tmphead == UART_TxTail ){
+        /* buffer full */
+        if ( UART_TxStalls < 0xFFFF ) UART_TxStalls++;
+        loops = 0;
+        while ( tmphead == UART_TxTail ){
+            /* wait for free space in buffer, letting the hook get on with other work */
+            if ( UART_TxWaitHook ) UART_TxWaitHook();
+            if ( ++loops >= UART_TX_TIMEOUT_LOOPS ){
+                if ( UART_TxDrops < 0xFFFF ) UART_TxDrops++;
+                return;
+            }
+        }
+    }
+    
+    UART_TxBuf[tmphead] = data;
+    UART_TxHead = tmphead;
+
+    /* enable UDRE interrupt */
+    UART_TX_START();
+
+}/* uart_putc */
+
+
+/*************************************************************************
+Function: uart_tryPutc()
+Purpose:  write byte to ringbuffer for transmitting via UART, or drop it if full
+Input:    byte to be transmitted
+Returns:  1 if queued, 0 if dropped
+**************************************************************************/
+unsigned char uart_tryPutc(unsigned char data)
+{
+    unsigned char tmphead;
+
+#if RS485_MULTIDROP
+    if ( UART_TxMute ) return 1;
+#endif
+
+    if ( UART_TxTap ) UART_TxTap(data);
+
+    tmphead  = (UART_TxHead + 1) & UART_TX_BUFFER_MASK;
+
+    if ( tmphead == UART_TxTail ){
+        if ( UART_TxDrops < 0xFFFF ) UART_TxDrops++;
+        return 0;
+    }
+
+    UART_TxBuf[tmphead] = data;
+    UART_TxHead = tmphead;
+
+    UART_TX_START();
+
+    return 1;
+
+}/* uart_tryPutc */
+
+
+/*************************************************************************
+Function: uart_write()
+Purpose:  write as many bytes as there is room for to ringbuffer, never waits
+Input:    bytes to be transmitted and their number
+Returns:  number of bytes written
+**************************************************************************/
+unsigned char uart_write(const unsigned char *data, unsigned char len)
+{
+    unsigned char tmphead;
+    unsigned char count;
+
+#if RS485_MULTIDROP
+    if ( UART_TxMute ) return len;
+#endif
+
+    tmphead = UART_TxHead;
+    for ( count = 0; count < len; count++ ){
+        tmphead = (tmphead + 1) & UART_TX_BUFFER_MASK;
+        if ( tmphead == UART_TxTail ) break;
+        if ( UART_TxTap ) UART_TxTap(data[count]);
+        UART_TxBuf[tmphead] = data[count];
+        /* publish each byte as soon as it is in, the ISR can start on it straight away */
+        UART_TxHead = tmphead;
+    }
+
+    if ( count ) UART_TX_START();
+
+    return count;
+
+}/* uart_write */
+
+
+/*************************************************************************
+Function: uart_txFree()
+Purpose:  number of bytes that can be put in the transmit ringbuffer without waiting
+Returns:  free space
+**************************************************************************/
+unsigned char uart_txFree(void)
+{
+    /* one slot is always left empty to tell full from empty */
+    return (UART_TxTail - UART_TxHead - 1) & UART_TX_BUFFER_MASK;
+
+}/* uart_txFree */
+
+
+void uart_setTxWaitHook(void (*hook)(void))
+{
+    UART_TxWaitHook = hook;
+
+}/* uart_setTxWaitHook */
+
+
+void uart_setTxTap(void (*tap)(unsigned char data))
+{
+    UART_TxTap = tap;
+
+}/* uart_setTxTap */
+
+
+#if RS485_MULTIDROP
+void uart_setTxMute(unsigned char mute)
+{
+    UART_TxMute = mute;
+
+}/* uart_setTxMute */
+#endif
+
+
+void uart_getTxStats(unsigned int *stalls, unsigned int *drops)
+{
+    *stalls = UART_TxStalls;
+    *drops = UART_TxDrops;
+
+}/* uart_getTxStats */
+
+
+void uart_clearTxStats(void)
+{
+    UART_TxStalls = 0;
+    UART_TxDrops = 0;
+
+}/* uart_clearTxStats */
+
+
+/*************************************************************************
+Function: uart_puts()
+Purpose:  transmit string to UART
+Input:    string to be transmitted
+Returns:  none          
+**************************************************************************/
+void uart_puts(const char *s )
+{
+    while (*s) 
+      uart_putc(*s++);
+
+}/* uart_puts */
+
+
+/*************************************************************************
+Function: uart_puts_p()
+Purpose:  transmit string from program memory to UART
+Input:    program memory string to be transmitted
+Returns:  none
+**************************************************************************/
+void uart_puts_p(const char *progmem_s )
+{
+    register char c;
+    
+    while ( (c = pgm_read_byte(progmem_s++)) ) 
+      uart_putc(c);
+
+}/* uart_puts_p */
+
+
@@ -1,164 +1,294 @@
-/*! \file uartsw2.c \brief Interrupt-driven Software UART Driver. */
-//*****************************************************************************
-//
-// File Name	: 'uartsw2.c'
-// Title		: Interrupt-driven Software UART Driver
-// Author		: Pascal Stang - Copyright (C) 2002-2004
-// Created		: 7/20/2002
-// Revised		: 4/27/2004
-// Version		: 0.6
-// Target MCU	: Atmel AVR Series (intended for the ATmega16 and ATmega32)
-// Editor Tabs	: 4
-//
-// This code is distributed under the GNU Public License
-//		which can be found at http://www.gnu.org/licenses/gpl.txt
-//
-//*****************************************************************************
-
-#include <avr/io.h>
-#include <avr/interrupt.h>
-
-#include "global.h"
-#include "timer.h"
-#include "uartsw_Tx.h"
-
-// Program ROM constants
-
-// Global variables
-
-// uartsw transmit status and data variables
-static volatile u08 UartswTxBusy;
-static volatile u08 UartswTxData;
-static volatile u08 UartswTxBitNum;
-
-// baud rate common to transmit and receive
-static volatile u08 UartswBaudRateDiv;
-
-
-// functions
-
-//! enable and initialize the Tx software uart
-void uartswInit_Tx(void)
-{
-    // initialize the buffers
-	//uartswInitBuffers();
-	// initialize the ports
-	sbi(UARTSW_TX_DDR, UARTSW_TX_PIN);
-	
-	// initialize baud rate
-	uartswSetBaudRate(9600);
-	
-	// setup the transmitter
-	UartswTxBusy = FALSE;
-	// disable OC2 interrupt
-	cbi(TIMSK, OCIE2);
-	// attach TxBit service routine to OC2
-	timerAttach(TIMER2OUTCOMPARE_INT, uartswTxBitService);
-		
-
-	// turn on interrupts
-	sei();
-}
-
-
-
-//! turns off software UART
-void uartswOff_Tx(void)
-{
-	// disable interrupts
-	cbi(TIMSK, OCIE2);
-
-	// detach the service routines
-	timerDetach(TIMER2OUTCOMPARE_INT);
-	
-}
-
-void uartswSetBaudRate(u32 baudrate)
-{
-	u16 div;
-
-	// set timer prescaler
-	if( baudrate > (F_CPU/64L*256L) ) 
-	//CHANGE THE ABOVE LINE IF CLOCK FREQ OF AVRLINX BOARD DIFFERS
-	//FROM AVRSAT
-	{
-		// if the requested baud rate is high,
-		// set timer prescalers to div-by-64
-		timer2SetPrescaler(TIMERRTC_CLK_DIV64);
-		
-		div = 64;
-	}
-	else
-	{
-		// if the requested baud rate is low,
-		// set timer prescalers to div-by-256
-		timer2SetPrescaler(TIMERRTC_CLK_DIV256);
-		
-		div = 256;
-	}
-
-	// calculate division factor for requested baud rate, and set it
-	//UartswBaudRateDiv = (u08)(((F_CPU/64L)+(baudrate/2L))/(baudrate*1L));
-	//UartswBaudRateDiv = (u08)(((F_CPU/256L)+(baudrate/2L))/(baudrate*1L));
-	UartswBaudRateDiv = (u08)(((F_CPU/div)+(baudrate/2L))/(baudrate*1L));
-}
-
-
-
-void uartswSendByte(u08 data)
-{
-	// wait until uart is ready
-	while(UartswTxBusy);
-	// set busy flag
-	UartswTxBusy = TRUE;
-	// save data
-	UartswTxData = data;
-	// set number of bits (+1 for stop bit)
-	UartswTxBitNum = 9;
-	
-	// set the start bit
-	cbi(UARTSW_TX_PORT, UARTSW_TX_PIN);//changed to cbi -JGM
-	// schedule the next bit
-	outb(OCR2, inb(TCNT2) + UartswBaudRateDiv); 
-	// enable OC2 interrupt
-	sbi(TIMSK, OCIE2);
-}
-
-
-
-void uartswTxBitService(void)
-{
-	if(UartswTxBitNum)
-	{
-		// there are bits still waiting to be transmitted
-		if(UartswTxBitNum > 1)
-		{
-			// transmit data bits (inverted, LSB first)
-			if( !(UartswTxData & 0x01) )
-				cbi(UARTSW_TX_PORT, UARTSW_TX_PIN);//changed to cbi -JGM
-			else
-				sbi(UARTSW_TX_PORT, UARTSW_TX_PIN);//changed to sbi -JGM
-			// shift bits down
-			UartswTxData = UartswTxData>>1;
-		}
-		else
-		{
-			// transmit stop bit
-			sbi(UARTSW_TX_PORT, UARTSW_TX_PIN);//changed to sbi -JGM
-		}
-		// schedule the next bit
-		outb(OCR2, inb(OCR2) + UartswBaudRateDiv); //WHAT IS INB?
-		// count down
-		UartswTxBitNum--;
-	}
-	else
-	{
-		// transmission is done
-		// clear busy flag
-		UartswTxBusy = FALSE;
-		// disable OC2 interrupt
-		cbi(TIMSK, OCIE2);
-	}
-}
-
-
+/*! \file uartsw2.c \brief Interrupt-driven Software UART Driver. */
+//*****************************************************************************
+//
+// File Name	: 'uartsw2.c'
+// Title		: Interrupt-driven Software UART Driver
+// Author		: Pascal Stang - Copyright (C) 2002-2004
+// Created		: 7/20/2002
+// Revised		: 4/27/2004
+// Version		: 0.6
+// Target MCU	: Atmel AVR Series (intended for the ATmega16 and ATmega32)
+// Editor Tabs	: 4
+//
+// This code is distributed under the GNU Public License
+//		which can be found at http://www.gnu.org/licenses/gpl.txt
+//
+//*****************************************************************************
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+#include "global.h"
+#include "timer.h"
+#include "uartsw_tx.h"
+
+#define UARTSW_TX_BUFFER_MASK	(UARTSW_TX_BUFFER_SIZE - 1)
+
+#if (UARTSW_TX_BUFFER_SIZE & UARTSW_TX_BUFFER_MASK)
+#error UARTSW_TX_BUFFER_SIZE is not a power of 2
+#endif
+
+// Program ROM constants
+
+// Timer2 prescalers to try, smallest first, and the division each gives
+static const u08 UartswPrescale[] PROGMEM =
+	{ TIMERRTC_CLK_DIV8, TIMERRTC_CLK_DIV32, TIMERRTC_CLK_DIV64, TIMERRTC_CLK_DIV128,
+	  TIMERRTC_CLK_DIV256, TIMERRTC_CLK_DIV1024 };
+static const u16 UartswPrescaleDiv[] PROGMEM = { 8, 32, 64, 128, 256, 1024 };
+
+// Global variables
+
+// uartsw transmit status and data variables
+static volatile u08 UartswTxBusy;
+static volatile u08 UartswTxData;
+static volatile u08 UartswTxBitNum;
+
+// transmit ring, filled by uartswSendByte() and emptied by the bit service as each byte
+// finishes. Head is only written with interrupts off, tail only by the bit service
+static volatile u08 UartswTxBuf[UARTSW_TX_BUFFER_SIZE];
+static volatile u08 UartswTxHead;
+static volatile u08 UartswTxTail;
+static volatile u16 UartswTxDrops;
+
+// baud rate common to transmit and receive
+static volatile u08 UartswBaudRateDiv;
+
+
+static inline void uartswTxStart(void);
+
+
+// functions
+
+//! enable and initialize the Tx software uart
+void uartswInit_Tx(void)
+{
+    // initialize the buffers
+	UartswTxHead = 0;
+	UartswTxTail = 0;
+	UartswTxDrops = 0;
+	// initialize the ports, idle high
+	sbi(UARTSW_TX_PORT, UARTSW_TX_PIN);
+	sbi(UARTSW_TX_DDR, UARTSW_TX_PIN);
+	
+	// Timer2 free running in normal mode, the bits are timed off OCR2A
+	TCCR2A = 0;
+
+	// initialize baud rate
+	uartswSetBaudRate(UARTSW_BAUD_RATE);
+	
+	// setup the transmitter
+	UartswTxBusy = FALSE;
+	// disable OC2A interrupt
+	cbi(TIMSK2, OCIE2A);
+#if !TIMER_STATIC_DISPATCH
+	// attach TxBit service routine to OC2A
+	timerAttach(TIMER2OUTCOMPARE_INT, uartswTxBitService);
+#endif
+
+	// interrupts are left for the caller to turn on once everything is set up
+}
+
+
+
+//! turns off software UART
+void uartswOff_Tx(void)
+{
+	// disable interrupts
+	cbi(TIMSK2, OCIE2A);
+	UartswTxBusy = FALSE;
+
+#if !TIMER_STATIC_DISPATCH
+	// detach the service routines
+	timerDetach(TIMER2OUTCOMPARE_INT);
+#endif
+	
+}
+
+u08 uartswSetBaudRate(u32 baudrate)
+{
+	u08 i;
+	u16 div;
+	u32 bitTics;
+
+	// use the smallest prescaler that gets a bit time into the 8 bit timer, for the
+	// finest timing. At 9600 baud and 3.6864MHz that is div-by-8, 48 tics per bit
+	for(i=0;i<(sizeof(UartswPrescaleDiv)/sizeof(UartswPrescaleDiv[0]));i++)
+	{
+		div = pgm_read_word(&UartswPrescaleDiv[i]);
+		bitTics = ((F_CPU/div)+(baudrate/2L))/baudrate;
+		if(bitTics <= 0xFF)
+		{
+			break;
+		}
+	}
+
+	// too slow for even the largest prescaler, or too fast to time at all
+	if( (i >= (sizeof(UartswPrescaleDiv)/sizeof(UartswPrescaleDiv[0]))) || (bitTics == 0) )
+	{
+		return FALSE;
+	}
+
+	timer2SetPrescaler(pgm_read_byte(&UartswPrescale[i]));
+	UartswBaudRateDiv = (u08)bitTics;
+	return TRUE;
+}
+
+
+
+//! start sending the next byte from the ring, with the bit service stopped
+static inline void uartswTxStart(void)
+{
+	UartswTxTail = (UartswTxTail + 1) & UARTSW_TX_BUFFER_MASK;
+	UartswTxData = UartswTxBuf[UartswTxTail];
+	// set number of bits (+1 for stop bit)
+	UartswTxBitNum = 9;
+	UartswTxBusy = TRUE;
+	
+	// set the start bit
+	cbi(UARTSW_TX_PORT, UARTSW_TX_PIN);//changed to cbi -JGM
+}
+
+
+
+u08 uartswSendByte(u08 data)
+{
+	u08 sreg;
+	u08 tmphead;
+
+	// may be called from interrupt handlers as well as the main loop, for tracing
+	sreg = SREG;
+	cli();
+
+	tmphead = (UartswTxHead + 1) & UARTSW_TX_BUFFER_MASK;
+	if(tmphead == UartswTxTail)
+	{
+		// full, drop the byte rather than hold up the caller
+		if(UartswTxDrops < 0xFFFF)
+			UartswTxDrops++;
+		SREG = sreg;
+		return FALSE;
+	}
+	UartswTxBuf[tmphead] = data;
+	UartswTxHead = tmphead;
+
+	if(!UartswTxBusy)
+	{
+		// idle, start this byte now
+		uartswTxStart();
+		// schedule the next bit
+		OCR2A = TCNT2 + UartswBaudRateDiv;
+		// clear any stale compare match and enable OC2A interrupt
+		TIFR2 = BV(OCF2A);
+		sbi(TIMSK2, OCIE2A);
+	}
+
+	SREG = sreg;
+	return TRUE;
+}
+
+
+
+void uartswSendStr_P(const char *progmem_s)
+{
+	u08 c;
+
+	while( (c = pgm_read_byte(progmem_s++)) )
+	{
+		if(!uartswSendByte(c))
+			break;
+	}
+}
+
+
+
+u08 uartswTxFree(void)
+{
+	// one slot is always left empty to tell full from empty
+	return (UartswTxTail - UartswTxHead - 1) & UARTSW_TX_BUFFER_MASK;
+}
+
+
+
+u16 uartswGetTxDrops(void)
+{
+	u08 sreg;
+	u16 drops;
+
+	sreg = SREG;
+	cli();
+	drops = UartswTxDrops;
+	SREG = sreg;
+
+	return drops;
+}
+
+
+
+void uartswClearTxDrops(void)
+{
+	u08 sreg;
+
+	sreg = SREG;
+	cli();
+	UartswTxDrops = 0;
+	SREG = sreg;
+}
+
+
+
+#if TIMER_STATIC_DISPATCH
+static inline void uartswTxBitService(void)
+#else
+void uartswTxBitService(void)
+#endif
+{
+	if(UartswTxBitNum)
+	{
+		// there are bits still waiting to be transmitted
+		if(UartswTxBitNum > 1)
+		{
+			// transmit data bits (inverted, LSB first)
+			if( !(UartswTxData & 0x01) )
+				cbi(UARTSW_TX_PORT, UARTSW_TX_PIN);//changed to cbi -JGM
+			else
+				sbi(UARTSW_TX_PORT, UARTSW_TX_PIN);//changed to sbi -JGM
+			// shift bits down
+			UartswTxData = UartswTxData>>1;
+		}
+		else
+		{
+			// transmit stop bit
+			sbi(UARTSW_TX_PORT, UARTSW_TX_PIN);//changed to sbi -JGM
+		}
+		// schedule the next bit, relative to the last compare so interrupt latency
+		// doesn't build up over the byte
+		OCR2A = OCR2A + UartswBaudRateDiv;
+		// count down
+		UartswTxBitNum--;
+	}
+	else if(UartswTxHead != UartswTxTail)
+	{
+		// stop bit done and more waiting, straight on with the next start bit
+		uartswTxStart();
+		OCR2A = OCR2A + UartswBaudRateDiv;
+	}
+	else
+	{
+		// transmission is done
+		// clear busy flag
+		UartswTxBusy = FALSE;
+		// disable OC2A interrupt
+		cbi(TIMSK2, OCIE2A);
+	}
+}
+
+#if TIMER_STATIC_DISPATCH
+//! Timer2 compare A, bound here rather than through timerAttach() so the bit
+//! service is inlined and the ISR only saves the registers it uses
+ISR(TIMER2_COMPA_vect)
+{
+	WAKE_MARK(WAKE_TIMER);
+	uartswTxBitService();
+}
+#endif